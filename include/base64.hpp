@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Base64 (RFC 4648, padded) used to embed raw arrays as XML text.
+// Both directions are table driven and branch free in their main loops: the encoder maps each 12-bit
+// half of a 3-byte group to two output characters with one lookup, and the decoder ORs four
+// pre-shifted lookups into a 24-bit group, folding invalid characters into a single error check
+// at the end, so the compiler can unroll and vectorize the loops without per-character branches.
+namespace XMLSerialization::base64 {
+
+namespace detail {
+
+inline constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Two output characters for every 12-bit value
+inline constexpr auto pair_table = [] {
+    std::array<char, 4096 * 2> table{};
+    for (size_t i = 0; i < 4096; ++i) {
+        table[2 * i] = alphabet[i >> 6];
+        table[2 * i + 1] = alphabet[i & 0x3F];
+    }
+    return table;
+}();
+
+// Any decoded group with this bit set contained a character outside the alphabet
+inline constexpr uint32_t invalid = 1u << 24;
+
+// The sextet of every character shifted into place for its position in a 4-character group
+template<int Shift>
+inline constexpr auto decode_table = [] {
+    std::array<uint32_t, 256> table{};
+    table.fill(invalid);
+    for (uint32_t i = 0; i < 64; ++i) {
+        table[static_cast<unsigned char>(alphabet[i])] = i << Shift;
+    }
+    return table;
+}();
+
+inline uint32_t decode_group(const unsigned char* in) {
+    return decode_table<18>[in[0]] | decode_table<12>[in[1]] | decode_table<6>[in[2]] | decode_table<0>[in[3]];
+}
+
+} // namespace detail
+
+// Number of characters encode() writes for size bytes
+inline constexpr size_t encoded_size(size_t size) {
+    return (size + 2) / 3 * 4;
+}
+
+// Encode size bytes from data into out, which must hold encoded_size(size) characters
+inline void encode(const void* data, size_t size, char* out) {
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    const char* pairs = detail::pair_table.data();
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3, out += 4) {
+        uint32_t group = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8 | in[i + 2];
+        std::memcpy(out, pairs + 2 * (group >> 12), 2);
+        std::memcpy(out + 2, pairs + 2 * (group & 0xFFF), 2);
+    }
+    if (size - i == 1) {
+        uint32_t group = uint32_t(in[i]) << 16;
+        out[0] = detail::alphabet[group >> 18];
+        out[1] = detail::alphabet[(group >> 12) & 0x3F];
+        out[2] = '=';
+        out[3] = '=';
+    } else if (size - i == 2) {
+        uint32_t group = uint32_t(in[i]) << 16 | uint32_t(in[i + 1]) << 8;
+        out[0] = detail::alphabet[group >> 18];
+        out[1] = detail::alphabet[(group >> 12) & 0x3F];
+        out[2] = detail::alphabet[(group >> 6) & 0x3F];
+        out[3] = '=';
+    }
+}
+
+inline std::string encode(const void* data, size_t size) {
+    std::string text(encoded_size(size), '\0');
+    encode(data, size, text.data());
+    return text;
+}
+
+// Number of bytes the length characters of padded base64 text decode to, or SIZE_MAX if the length is not valid
+inline size_t decoded_size(const char* text, size_t length) {
+    if (length % 4 != 0) {
+        return SIZE_MAX;
+    }
+    size_t size = length / 4 * 3;
+    if (length > 0 && text[length - 1] == '=') {
+        size -= text[length - 2] == '=' ? 2 : 1;
+    }
+    return size;
+}
+
+// Decode length characters of padded base64 text into out, which must hold decoded_size(text, length) bytes.
+// Returns false if the text is malformed
+inline bool decode(const char* text, size_t length, void* data) {
+    size_t size = decoded_size(text, length);
+    if (size == SIZE_MAX) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(text);
+    unsigned char* out = static_cast<unsigned char*>(data);
+
+    // every group but the last one, which may carry padding
+    size_t groups = length / 4 - 1;
+    uint32_t error = 0;
+    for (size_t g = 0; g < groups; ++g, in += 4, out += 3) {
+        uint32_t group = detail::decode_group(in);
+        error |= group;
+        out[0] = static_cast<unsigned char>(group >> 16);
+        out[1] = static_cast<unsigned char>(group >> 8);
+        out[2] = static_cast<unsigned char>(group);
+    }
+
+    size_t tail = size - groups * 3;
+    unsigned char last[4] = {in[0], in[1], in[2], in[3]};
+    if (tail < 3) {
+        last[3] = 'A';
+        if (tail < 2) {
+            last[2] = 'A';
+        }
+    }
+    uint32_t group = detail::decode_group(last);
+    error |= group;
+    // padding must come last and the bits it drops must be zero
+    if ((tail == 1 && (group & 0xFFFF)) || (tail == 2 && (group & 0xFF))) {
+        return false;
+    }
+    for (size_t k = 0; k < tail; ++k) {
+        out[k] = static_cast<unsigned char>(group >> (16 - 8 * k));
+    }
+    return (error & detail::invalid) == 0;
+}
+
+} // namespace XMLSerialization::base64
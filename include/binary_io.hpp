@@ -0,0 +1,526 @@
+#pragma once
+#include <iostream>
+#include <streambuf>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+#include <cstdint>
+#include <bit>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <fstream>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace BinarySerialization{
+
+// Wire format options. A BinaryReader must use the same format as the BinaryWriter
+// that produced its input; plain std::ostream/std::istream always use the default format.
+struct BinaryFormat {
+    // Write container sizes and string lengths as unsigned LEB128 varints instead of raw size_t
+    bool compact_lengths = false;
+    // Write integers wider than one byte as varints: unsigned as plain LEB128, signed zigzag-encoded
+    bool varint_integers = false;
+};
+
+namespace detail {
+// Longest LEB128 encoding of a 64-bit value
+constexpr size_t max_varint_bytes = 10;
+
+// Encode `value` as an unsigned LEB128 varint, returning the number of bytes used
+inline size_t encode_varint(uint64_t value, char* out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<char>(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<char>(value);
+    return n;
+}
+
+// Number of bytes encode_varint produces for `value`
+inline size_t varint_size(uint64_t value) {
+    return (static_cast<size_t>(std::bit_width(value | 1)) + 6) / 7;
+}
+
+// ZigZag mapping of signed to unsigned values, so small magnitudes of either sign encode short
+inline uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+}
+
+// A buffered sink for binary serialization.
+// Bytes are collected in one contiguous buffer and handed to the underlying
+// std::ostream, FILE* or file descriptor only when the buffer is full or on flush(),
+// so serializing many small values costs a memcpy each instead of a stream call each.
+class BinaryWriter {
+public:
+    static constexpr size_t default_capacity = 1 << 16;
+
+    // Write to a std::ostream
+    explicit BinaryWriter(std::ostream& os, size_t capacity = default_capacity)
+        : sink_(Sink::stream), os_(&os), file_(nullptr), fd_(-1) { allocate(capacity); }
+
+    // Write to a C stdio stream
+    explicit BinaryWriter(FILE* file, size_t capacity = default_capacity)
+        : sink_(Sink::file), os_(nullptr), file_(file), fd_(-1) { allocate(capacity); }
+
+    // Write to a raw file descriptor
+    explicit BinaryWriter(int fd, size_t capacity = default_capacity)
+        : sink_(Sink::fd), os_(nullptr), file_(nullptr), fd_(fd) { allocate(capacity); }
+
+    BinaryWriter(const BinaryWriter&) = delete;
+    BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+    // Pending bytes are flushed on destruction; errors can only be observed through an explicit flush()
+    ~BinaryWriter() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    // Append raw bytes to the buffer
+    void write(const void* data, size_t size) {
+        if (size <= capacity_ - used_) {
+            std::memcpy(buffer_.get() + used_, data, size);
+            used_ += size;
+        } else {
+            write_slow(data, size);
+        }
+        written_ += size;
+    }
+
+    // Append an unsigned LEB128 varint
+    void write_varint(uint64_t value) {
+        if (capacity_ - used_ >= detail::max_varint_bytes) {
+            size_t n = detail::encode_varint(value, buffer_.get() + used_);
+            used_ += n;
+            written_ += n;
+        } else {
+            char bytes[detail::max_varint_bytes];
+            write(bytes, detail::encode_varint(value, bytes));
+        }
+    }
+
+    // Hand everything buffered so far to the underlying sink
+    void flush() {
+        drain();
+        if (sink_ == Sink::stream) {
+            os_->flush();
+        } else if (sink_ == Sink::file) {
+            std::fflush(file_);
+        }
+    }
+
+    // Total number of bytes accepted by this writer, flushed or not
+    size_t bytes_written() const { return written_; }
+
+    size_t capacity() const { return capacity_; }
+
+    const BinaryFormat& format() const { return format_; }
+    void set_format(const BinaryFormat& format) { format_ = format; }
+
+private:
+    enum class Sink { stream, file, fd };
+
+    void allocate(size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("binary writer capacity must not be zero");
+        }
+        buffer_ = std::make_unique<char[]>(capacity);
+        capacity_ = capacity;
+    }
+
+    // The buffer cannot take the whole write: drain it, then either buffer the
+    // new bytes or, if they would not fit anyway, pass them straight through
+    void write_slow(const void* data, size_t size) {
+        drain();
+        if (size >= capacity_) {
+            put(static_cast<const char*>(data), size);
+        } else {
+            std::memcpy(buffer_.get(), data, size);
+            used_ = size;
+        }
+    }
+
+    void drain() {
+        if (used_ > 0) {
+            size_t pending = used_;
+            used_ = 0;
+            put(buffer_.get(), pending);
+        }
+    }
+
+    void put(const char* data, size_t size) {
+        switch (sink_) {
+        case Sink::stream:
+            os_->write(data, static_cast<std::streamsize>(size));
+            if (os_->fail()) {
+                throw std::runtime_error("binary writer: stream write failed");
+            }
+            break;
+        case Sink::file:
+            if (std::fwrite(data, 1, size, file_) != size) {
+                throw std::runtime_error("binary writer: file write failed");
+            }
+            break;
+        case Sink::fd:
+            while (size > 0) {
+#if defined(_WIN32)
+                int n = _write(fd_, data, static_cast<unsigned>(size > 0x40000000 ? 0x40000000 : size));
+#else
+                ssize_t n = ::write(fd_, data, size);
+#endif
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error("binary writer: fd write failed");
+                }
+                data += n;
+                size -= static_cast<size_t>(n);
+            }
+            break;
+        }
+    }
+
+    Sink sink_;
+    std::ostream* os_;
+    FILE* file_;
+    int fd_;
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t written_ = 0;
+    BinaryFormat format_;
+};
+
+// A sink that only counts bytes, used to compute exact serialized sizes without writing anything
+class SizeCounter {
+public:
+    explicit SizeCounter(const BinaryFormat& format = BinaryFormat()) : format_(format) {}
+
+    void write(const void*, size_t size) { count_ += size; }
+    void write_varint(uint64_t value) { count_ += detail::varint_size(value); }
+
+    // Account for bytes whose size is already known, e.g. from a user-provided serialized_size
+    void add(size_t size) { count_ += size; }
+
+    size_t bytes_written() const { return count_; }
+    const BinaryFormat& format() const { return format_; }
+
+private:
+    size_t count_ = 0;
+    BinaryFormat format_;
+};
+
+// A sink over caller-provided memory. Nothing is allocated; a write that does not fit marks the
+// writer as overflowed and every later write is dropped, so the caller checks once at the end
+class SpanWriter {
+public:
+    explicit SpanWriter(std::span<std::byte> buffer, const BinaryFormat& format = BinaryFormat())
+        : begin_(reinterpret_cast<char*>(buffer.data())), cur_(begin_), end_(begin_ + buffer.size()), format_(format) {}
+
+    void write(const void* data, size_t size) {
+        if (size <= static_cast<size_t>(end_ - cur_)) {
+            std::memcpy(cur_, data, size);
+            cur_ += size;
+        } else {
+            overflowed_ = true;
+            cur_ = end_;
+        }
+    }
+
+    void write_varint(uint64_t value) {
+        if (static_cast<size_t>(end_ - cur_) >= detail::max_varint_bytes) {
+            cur_ += detail::encode_varint(value, cur_);
+        } else {
+            char bytes[detail::max_varint_bytes];
+            write(bytes, detail::encode_varint(value, bytes));
+        }
+    }
+
+    bool overflowed() const { return overflowed_; }
+    size_t bytes_written() const { return static_cast<size_t>(cur_ - begin_); }
+    const BinaryFormat& format() const { return format_; }
+
+private:
+    char* begin_;
+    char* cur_;
+    char* end_;
+    bool overflowed_ = false;
+    BinaryFormat format_;
+};
+
+// A read-only memory mapping of a whole file, for handing large snapshots to a BinaryReader
+// at page-cache speed. Pages are mapped shared with other readers of the same file and the
+// kernel is told the file will be read front to back. Where mmap is unavailable the file
+// is read into memory instead.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) {
+            throw std::runtime_error("mapped file: cannot open " + path);
+        }
+        fallback_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("mapped file: cannot open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("mapped file: cannot stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("mapped file: cannot map " + path);
+            }
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+            ::madvise(addr, size_, MADV_WILLNEED);
+            data_ = static_cast<const char*>(addr);
+        }
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept { swap(other); }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        MappedFile(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~MappedFile() {
+#if !defined(_WIN32)
+        if (data_) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::span<const std::byte> bytes() const { return {reinterpret_cast<const std::byte*>(data_), size_}; }
+
+private:
+    void swap(MappedFile& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+#if defined(_WIN32)
+        std::swap(fallback_, other.fallback_);
+#endif
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    std::vector<char> fallback_;
+#endif
+};
+
+// A bounds-checked source for binary deserialization.
+// Reads bump a cursor through one contiguous byte range, either borrowed from the
+// caller or owned by the reader. Every read checks the end of the buffer exactly once
+// and throws on truncated input instead of leaving the target half-filled.
+class BinaryReader {
+public:
+    // Borrow a byte range; it must outlive the reader
+    BinaryReader(const void* data, size_t size)
+        : begin_(static_cast<const char*>(data)), cur_(begin_), end_(begin_ + size) {}
+
+    explicit BinaryReader(std::span<const std::byte> bytes)
+        : BinaryReader(bytes.data(), bytes.size()) {}
+
+    // Take ownership of a buffer
+    explicit BinaryReader(std::vector<char> buffer)
+        : owned_(std::move(buffer)), begin_(owned_.data()), cur_(begin_), end_(begin_ + owned_.size()) {}
+
+    // Take ownership of a memory-mapped file
+    explicit BinaryReader(MappedFile file)
+        : mapped_(std::move(file)), begin_(mapped_.data()), cur_(begin_), end_(begin_ + mapped_.size()) {}
+
+    // Slurp the rest of a stream into an owned buffer
+    explicit BinaryReader(std::istream& is)
+        : BinaryReader(std::vector<char>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>())) {}
+
+    BinaryReader(const BinaryReader&) = delete;
+    BinaryReader& operator=(const BinaryReader&) = delete;
+    BinaryReader(BinaryReader&&) = default;
+    BinaryReader& operator=(BinaryReader&&) = default;
+
+    // Copy the next `size` bytes out of the buffer
+    void read(void* data, size_t size) {
+        if (size > static_cast<size_t>(end_ - cur_)) {
+            truncated(size);
+        }
+        std::memcpy(data, cur_, size);
+        cur_ += size;
+    }
+
+    // Read an unsigned LEB128 varint; single-byte values take the fast path
+    uint64_t read_varint() {
+        if (cur_ != end_ && static_cast<uint8_t>(*cur_) < 0x80) {
+            return static_cast<uint8_t>(*cur_++);
+        }
+        return read_varint_slow();
+    }
+
+    // Decode `count` consecutive varints into `out`, passing each raw value through `convert`.
+    // While a maximal varint is guaranteed to fit, bytes are decoded without per-byte bounds checks
+    template<typename T, typename Convert>
+    void read_varints(T* out, size_t count, Convert convert) {
+        size_t i = 0;
+        const char* p = cur_;
+        while (i < count && static_cast<size_t>(end_ - p) >= detail::max_varint_bytes) {
+            uint64_t value = static_cast<uint8_t>(*p++);
+            if (value >= 0x80) {
+                value &= 0x7f;
+                for (unsigned shift = 7;; shift += 7) {
+                    uint8_t byte = static_cast<uint8_t>(*p++);
+                    // The 10th byte holds only bit 63: anything more would overflow, or continue past 10 bytes
+                    if (shift == 63 && byte > 1) {
+                        cur_ = p;
+                        throw std::runtime_error("binary reader: malformed varint at offset " + std::to_string(position()));
+                    }
+                    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if (byte < 0x80) {
+                        break;
+                    }
+                }
+            }
+            cur_ = p;
+            out[i++] = convert(value);
+        }
+        for (; i < count; ++i) {
+            out[i] = convert(read_varint());
+        }
+    }
+
+    // Advance over the next `size` bytes and return where they start
+    const char* skip(size_t size) {
+        if (size > static_cast<size_t>(end_ - cur_)) {
+            truncated(size);
+        }
+        const char* start = cur_;
+        cur_ += size;
+        return start;
+    }
+
+    size_t position() const { return static_cast<size_t>(cur_ - begin_); }
+    size_t remaining() const { return static_cast<size_t>(end_ - cur_); }
+    size_t size() const { return static_cast<size_t>(end_ - begin_); }
+    bool eof() const { return cur_ == end_; }
+
+    const BinaryFormat& format() const { return format_; }
+    void set_format(const BinaryFormat& format) { format_ = format; }
+
+private:
+    uint64_t read_varint_slow() {
+        uint64_t value = 0;
+        const char* p = cur_;
+        for (size_t i = 0; i < detail::max_varint_bytes; ++i) {
+            if (p == end_) {
+                truncated(static_cast<size_t>(p - cur_) + 1);
+            }
+            uint8_t byte = static_cast<uint8_t>(*p++);
+            if (i == detail::max_varint_bytes - 1 && byte > 1) {
+                break; // the 10th byte holds only bit 63
+            }
+            value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+            if (byte < 0x80) {
+                cur_ = p;
+                return value;
+            }
+        }
+        throw std::runtime_error("binary reader: malformed varint at offset " + std::to_string(position()));
+    }
+
+    [[noreturn]] void truncated(size_t size) const {
+        throw std::runtime_error("binary reader: truncated input, needed " + std::to_string(size) +
+                                 " bytes at offset " + std::to_string(position()) +
+                                 " but only " + std::to_string(remaining()) + " remain");
+    }
+
+    std::vector<char> owned_;
+    MappedFile mapped_;
+    const char* begin_;
+    const char* cur_;
+    const char* end_;
+    BinaryFormat format_;
+};
+
+// A std::streambuf that forwards everything written to it to a BinaryWriter, SizeCounter or SpanWriter,
+// so a user type that only knows how to write to a std::ostream can still be written to them
+template<typename Out>
+class SinkStreambuf : public std::streambuf {
+public:
+    explicit SinkStreambuf(Out& out) : out_(out) {}
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        out_.write(data, static_cast<size_t>(size));
+        return size;
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            char c = traits_type::to_char_type(ch);
+            out_.write(&c, 1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+private:
+    Out& out_;
+};
+
+// A std::streambuf over the unread bytes of a BinaryReader, so a user type that only knows how to read
+// from a std::istream can still be read from one. Whatever was consumed is skipped in the reader on destruction
+class ReaderStreambuf : public std::streambuf {
+public:
+    explicit ReaderStreambuf(BinaryReader& reader) : reader_(reader) {
+        // The bytes are only ever read; std::streambuf just wants non-const pointers
+        char* begin = const_cast<char*>(reader.skip(0));
+        setg(begin, begin, begin + reader.remaining());
+    }
+
+    ~ReaderStreambuf() override {
+        reader_.skip(static_cast<size_t>(gptr() - eback()));
+    }
+
+private:
+    BinaryReader& reader_;
+};
+
+};
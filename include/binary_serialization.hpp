@@ -6,178 +6,622 @@
 #include <list>
 #include <set>
 #include <map>
+#include <array>
+#include <string_view>
+#include <span>
+#include <optional>
+#include <iterator>
+#include <utility>
 #include <type_traits>
 #include <memory>
 #include <cassert>
+#include <limits>
+#include <algorithm>
+#include "binary_io.hpp"
 
 #define ASSERT(expr, message) assert((expr) && (message))
 
 
 namespace BinarySerialization{
 
-// Serialize arithmetic types to a binary stream
+// Types whose in-memory bytes are exactly their serialized form, so a contiguous run of them
+// is written and read as one block copy instead of element by element.
+// Specialize to std::true_type for trivially copyable user structs that should be stored raw
+// (such types are then serialized by value and must not also provide serialize members).
 template<typename T>
-typename std::enable_if<std::is_arithmetic<T>::value, void>::type
-serialize(const T& value, std::ostream& os) {
-    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+struct is_block_serializable : std::is_arithmetic<T> {};
+
+namespace detail {
+// Read raw bytes from a std::istream or BinaryReader, throwing if the input ends early
+template<typename In>
+void read_raw(In& is, void* data, size_t size) {
+    if constexpr (std::is_base_of<std::istream, In>::value) {
+        is.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+        if (is.fail()) {
+            throw std::runtime_error("unexpected end of binary stream");
+        }
+    } else {
+        is.read(data, size);
+    }
+}
+
+// Write a container size or string length: a raw size_t, or a varint in the compact format
+template<typename Out>
+void write_size(Out& os, size_t size) {
+    if constexpr (std::is_base_of<std::ostream, Out>::value) {
+        os.write(reinterpret_cast<const char *>(&size), sizeof(size_t));
+    } else {
+        if (os.format().compact_lengths) {
+            os.write_varint(size);
+        } else {
+            os.write(&size, sizeof(size_t));
+        }
+    }
+}
+
+// Read a container size or string length written by write_size
+template<typename In>
+size_t read_size(In& is) {
+    if constexpr (std::is_base_of<std::istream, In>::value) {
+        size_t size;
+        read_raw(is, &size, sizeof(size_t));
+        return size;
+    } else {
+        if (is.format().compact_lengths) {
+            uint64_t size = is.read_varint();
+            if constexpr (sizeof(size_t) < sizeof(uint64_t)) {
+                if (size > std::numeric_limits<size_t>::max()) {
+                    throw std::runtime_error("binary reader: length does not fit in size_t");
+                }
+            }
+            return static_cast<size_t>(size);
+        }
+        size_t size;
+        is.read(&size, sizeof(size_t));
+        return size;
+    }
+}
+
+// Reject element counts that cannot possibly fit in what is left of a BinaryReader,
+// before a corrupted length turns into a huge allocation
+template<typename In>
+void check_count(In& is, size_t count, size_t element_size) {
+    if constexpr (!std::is_base_of<std::istream, In>::value) {
+        if (element_size != 0 && count > is.remaining() / element_size) {
+            throw std::runtime_error("binary reader: element count exceeds remaining input");
+        }
+    }
+}
+
+// Whether a contiguous run of T can go through one block copy
+template<typename T>
+constexpr bool block_copyable = is_block_serializable<T>::value && std::is_trivially_copyable<T>::value;
+
+// Integers that may be written as varints; bool and the char types are always a single raw byte
+template<typename T>
+constexpr bool varint_encodable = std::is_integral<T>::value && (sizeof(T) > 1);
+
+// Fewest bytes any serialized T can take, used to bound element counts by the input left.
+// Only types whose layout is known count: block copies and length-prefixed containers take at least a byte,
+// fixed-size aggregates add up their members, and anything else (e.g. a user type that may write nothing) takes 0
+template<typename T>
+struct min_serialized_size : std::integral_constant<size_t, block_copyable<T> ? 1 : 0> {};
+
+template<>
+struct min_serialized_size<std::string> : std::integral_constant<size_t, 1> {};
+
+template<typename T>
+struct min_serialized_size<std::vector<T>> : std::integral_constant<size_t, 1> {};
+
+template<typename T>
+struct min_serialized_size<std::list<T>> : std::integral_constant<size_t, 1> {};
+
+template<typename T>
+struct min_serialized_size<std::set<T>> : std::integral_constant<size_t, 1> {};
+
+template<typename K, typename V>
+struct min_serialized_size<std::map<K, V>> : std::integral_constant<size_t, 1> {};
+
+template<typename K, typename V>
+struct min_serialized_size<std::pair<K, V>>
+    : std::integral_constant<size_t, min_serialized_size<K>::value + min_serialized_size<V>::value> {};
+
+template<typename T, size_t N>
+struct min_serialized_size<std::array<T, N>> : std::integral_constant<size_t, N * min_serialized_size<T>::value> {};
+
+template<typename T, size_t N>
+struct min_serialized_size<T[N]> : std::integral_constant<size_t, N * min_serialized_size<T>::value> {};
+
+// Most elements reserved ahead of reading when their count cannot be checked against the input;
+// past it, capacity grows with what was actually read
+constexpr size_t unchecked_reserve_limit = 4096;
+
+// Whether an archive asked for varint integers; plain streams never do
+template<typename Stream>
+bool varint_integers(const Stream& stream) {
+    if constexpr (std::is_base_of<std::ios_base, Stream>::value) {
+        return false;
+    } else {
+        return stream.format().varint_integers;
+    }
+}
+
+// Map an integer to its varint payload
+template<typename T>
+uint64_t to_varint(T value) {
+    if constexpr (std::is_signed<T>::value) {
+        return zigzag_encode(static_cast<int64_t>(value));
+    } else {
+        return static_cast<uint64_t>(value);
+    }
+}
+
+// Map a varint payload back to an integer, rejecting values that do not fit in T
+template<typename T>
+T from_varint(uint64_t value) {
+    if constexpr (std::is_signed<T>::value) {
+        int64_t decoded = zigzag_decode(value);
+        if (decoded < std::numeric_limits<T>::min() || decoded > std::numeric_limits<T>::max()) {
+            throw std::runtime_error("varint value out of range");
+        }
+        return static_cast<T>(decoded);
+    } else {
+        if (value > std::numeric_limits<T>::max()) {
+            throw std::runtime_error("varint value out of range");
+        }
+        return static_cast<T>(value);
+    }
+}
+
+// Write one integer as a varint
+template<typename T, typename Out>
+void write_varint(Out& os, T value) {
+    if constexpr (std::is_base_of<std::ostream, Out>::value) {
+        char bytes[max_varint_bytes];
+        os.write(bytes, static_cast<std::streamsize>(encode_varint(to_varint(value), bytes)));
+    } else {
+        os.write_varint(to_varint(value));
+    }
+}
+
+// Read one integer written by write_varint
+template<typename T, typename In>
+T read_varint(In& is) {
+    if constexpr (std::is_base_of<std::istream, In>::value) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < max_varint_bytes; ++i) {
+            uint8_t byte;
+            read_raw(is, &byte, 1);
+            if (i == max_varint_bytes - 1 && byte > 1) {
+                break; // the 10th byte holds only bit 63
+            }
+            value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+            if (byte < 0x80) {
+                return from_varint<T>(value);
+            }
+        }
+        throw std::runtime_error("malformed varint in binary stream");
+    } else {
+        return from_varint<T>(is.read_varint());
+    }
+}
+
+// Write a contiguous run of block serializable values: one block copy,
+// or one varint per element when the archive encodes integers as varints
+template<typename T, typename Out>
+void write_block(Out& os, const T* data, size_t count) {
+    if constexpr (varint_encodable<T>) {
+        if (varint_integers(os)) {
+            for (size_t i = 0; i < count; ++i) {
+                write_varint(os, data[i]);
+            }
+            return;
+        }
+    }
+    os.write(reinterpret_cast<const char *>(data), count * sizeof(T));
 }
 
-// Deserialize arithmetic types from a binary stream
+// Read a contiguous run written by write_block; varints are decoded in one batch
+template<typename T, typename In>
+void read_block(In& is, T* data, size_t count) {
+    if constexpr (varint_encodable<T> && !std::is_base_of<std::istream, In>::value) {
+        if (varint_integers(is)) {
+            is.read_varints(data, count, from_varint<T>);
+            return;
+        }
+    }
+    read_raw(is, reinterpret_cast<char *>(data), count * sizeof(T));
+}
+}
+
+// Opt-in varint encoding for a single call: serialize(varint(x), os) / deserialize(varint(x), is).
+// Works with plain streams and archives alike, for integers and std::vector of integers; bool is not an integer here.
+template<typename T>
+struct VarInt {
+    T& value;
+};
+
 template<typename T>
-typename std::enable_if<std::is_arithmetic<T>::value, void>::type
-deserialize(T& value, std::istream& is) {
-    is.read(reinterpret_cast<char *>(&value), sizeof(T));
+VarInt<T> varint(T& value) {
+    return VarInt<T>{value};
+}
+
+// Serialize an integer or a vector of integers as varints
+template<typename T, typename Out>
+void serialize(const VarInt<T>& wrapper, Out& os) {
+    using U = typename std::remove_cv<T>::type;
+    if constexpr (std::is_integral<U>::value) {
+        static_assert(!std::is_same<U, bool>::value, "varint() does not support bool");
+        detail::write_varint(os, wrapper.value);
+    } else {
+        using E = typename U::value_type;
+        static_assert(std::is_same<U, std::vector<E>>::value && std::is_integral<E>::value,
+                      "varint() supports integers and std::vector of integers");
+        static_assert(!std::is_same<E, bool>::value, "varint() does not support std::vector<bool>");
+        detail::write_size(os, wrapper.value.size());
+        for (const auto& element : wrapper.value) {
+            detail::write_varint(os, element);
+        }
+    }
+}
+
+// Deserialize an integer or a vector of integers written as varints
+template<typename T, typename In>
+void deserialize(VarInt<T> wrapper, In& is) {
+    if constexpr (std::is_integral<T>::value) {
+        static_assert(!std::is_same<T, bool>::value, "varint() does not support bool");
+        wrapper.value = detail::read_varint<T>(is);
+    } else {
+        using E = typename T::value_type;
+        static_assert(std::is_same<T, std::vector<E>>::value && std::is_integral<E>::value,
+                      "varint() supports integers and std::vector of integers");
+        static_assert(!std::is_same<E, bool>::value, "varint() does not support std::vector<bool>");
+        size_t size = detail::read_size(is);
+        detail::check_count(is, size, 1);
+        wrapper.value.resize(size);
+        if constexpr (std::is_base_of<std::istream, In>::value) {
+            for (auto& element : wrapper.value) {
+                element = detail::read_varint<E>(is);
+            }
+        } else {
+            is.read_varints(wrapper.value.data(), size, detail::from_varint<E>);
+        }
+    }
+}
+
+// Serialize arithmetic (and other block serializable) types to a binary stream (std::ostream or BinaryWriter)
+template<typename T, typename Out>
+typename std::enable_if<is_block_serializable<T>::value, void>::type
+serialize(const T& value, Out& os) {
+    if constexpr (detail::varint_encodable<T>) {
+        if (detail::varint_integers(os)) {
+            detail::write_varint(os, value);
+            return;
+        }
+    }
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Deserialize arithmetic (and other block serializable) types from a binary stream (std::istream or BinaryReader)
+template<typename T, typename In>
+typename std::enable_if<is_block_serializable<T>::value, void>::type
+deserialize(T& value, In& is) {
+    if constexpr (detail::varint_encodable<T>) {
+        if (detail::varint_integers(is)) {
+            value = detail::read_varint<T>(is);
+            return;
+        }
+    }
+    detail::read_raw(is, reinterpret_cast<char *>(&value), sizeof(T));
 }
 
 // Serialize std::string to a binary stream
-void serialize(const std::string& value, std::ostream& os) {
+template<typename Out>
+void serialize(const std::string& value, Out& os) {
     size_t size = value.size();
-    os.write(reinterpret_cast<const char*>(&size), sizeof(size_t)); // Write string size
+    detail::write_size(os, size); // Write string size
     os.write(value.c_str(), size); // Write string content
 }
 
 // Deserialize std::string from a binary stream
-void deserialize(std::string& value, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char *>(&size), sizeof(size_t)); // Read string size
+template<typename In>
+void deserialize(std::string& value, In& is) {
+    size_t size = detail::read_size(is); // Read string size
+    detail::check_count(is, size, 1);
     value.resize(size);
-    is.read(&value[0], size); // Read string content
+    detail::read_raw(is, &value[0], size); // Read string content
+}
+
+// Serialize std::array to a binary stream (the size is part of the type, so no header is written)
+template<typename T, size_t N, typename Out>
+void serialize(const std::array<T, N>& arr, Out& os) {
+    if constexpr (detail::block_copyable<T> && N != 0) { // data() of an empty array may be null
+        detail::write_block(os, arr.data(), N); // Write the whole array in one block
+    } else {
+        for (const auto& element : arr) {
+            serialize(element, os); // Serialize each element in the array
+        }
+    }
+}
+
+// Deserialize std::array from a binary stream
+template<typename T, size_t N, typename In>
+void deserialize(std::array<T, N>& arr, In& is) {
+    if constexpr (detail::block_copyable<T> && N != 0) { // data() of an empty array may be null
+        detail::read_block(is, arr.data(), N); // Read the whole array in one block
+    } else {
+        for (auto& element : arr) {
+            deserialize(element, is); // Deserialize each element in the array
+        }
+    }
+}
+
+// Serialize a C array to a binary stream (the size is part of the type, so no header is written)
+// char arrays are left to the std::string overload so string literals keep their meaning
+template<typename T, size_t N, typename Out>
+typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value, void>::type
+serialize(const T (&arr)[N], Out& os) {
+    if constexpr (detail::block_copyable<T>) {
+        detail::write_block(os, arr, N); // Write the whole array in one block
+    } else {
+        for (const auto& element : arr) {
+            serialize(element, os); // Serialize each element in the array
+        }
+    }
+}
+
+// Deserialize a C array from a binary stream
+template<typename T, size_t N, typename In>
+typename std::enable_if<!std::is_same<T, char>::value, void>::type
+deserialize(T (&arr)[N], In& is) {
+    if constexpr (detail::block_copyable<T>) {
+        detail::read_block(is, arr, N); // Read the whole array in one block
+    } else {
+        for (auto& element : arr) {
+            deserialize(element, is); // Deserialize each element in the array
+        }
+    }
 }
 
 // Serialize std::vector to a binary stream
-template<typename T>
-void serialize(const std::vector<T>& vec, std::ostream& os) {
+template<typename T, typename Out>
+void serialize(const std::vector<T>& vec, Out& os) {
     size_t size = vec.size();
-    os.write(reinterpret_cast<const char *>(&size), sizeof(size_t)); // Write vector size
-    for (const auto& element : vec) {
-        serialize(element, os); // Serialize each element in the vector
+    detail::write_size(os, size); // Write vector size
+    if constexpr (detail::block_copyable<T> && !std::is_same<T, bool>::value) {
+        detail::write_block(os, vec.data(), size); // Write the whole vector in one block
+    } else {
+        for (const auto& element : vec) {
+            serialize(element, os); // Serialize each element in the vector
+        }
     }
 }
 
 // Deserialize std::vector from a binary stream
+template<typename T, typename In>
+void deserialize(std::vector<T>& vec, In& is) {
+    size_t size = detail::read_size(is); // Read vector size
+    if constexpr (detail::block_copyable<T> && !std::is_same<T, bool>::value) {
+        detail::check_count(is, size, detail::varint_integers(is) ? 1 : sizeof(T));
+        vec.resize(size);
+        detail::read_block(is, vec.data(), size); // Read the whole vector in one block
+    } else if constexpr (detail::min_serialized_size<T>::value != 0) {
+        detail::check_count(is, size, detail::min_serialized_size<T>::value);
+        vec.resize(size);
+        for (auto& element : vec) {
+            deserialize(element, is); // Deserialize each element in the vector
+        }
+    } else {
+        vec.clear();
+        vec.reserve(std::min(size, detail::unchecked_reserve_limit));
+        for (size_t i = 0; i < size; i++) {
+            deserialize(vec.emplace_back(), is); // Deserialize each element in the vector
+        }
+    }
+}
+
+// Serialize std::string_view to a binary stream, in the same layout as std::string
+// (constrained to exact string_view arguments so string literals keep using the std::string overload)
+template<typename S, typename Out>
+typename std::enable_if<std::is_same<S, std::string_view>::value, void>::type
+serialize(const S& value, Out& os) {
+    size_t size = value.size();
+    detail::write_size(os, size); // Write string size
+    os.write(value.data(), size); // Write string content
+}
+
+// Deserialize a string as a view into the reader's buffer, without allocating or copying.
+// The view is only valid while the buffer behind the BinaryReader is alive
+inline void deserialize(std::string_view& value, BinaryReader& is) {
+    size_t size = detail::read_size(is); // Read string size
+    value = std::string_view(is.skip(size), size);
+}
+
+// Serialize std::span to a binary stream, in the same layout as std::vector
+template<typename T, size_t Extent, typename Out>
+void serialize(const std::span<T, Extent>& span, Out& os) {
+    using E = typename std::remove_cv<T>::type;
+    size_t size = span.size();
+    detail::write_size(os, size); // Write span size
+    if constexpr (detail::block_copyable<E>) {
+        detail::write_block(os, span.data(), size); // Write the whole span in one block
+    } else {
+        for (const auto& element : span) {
+            serialize(element, os); // Serialize each element in the span
+        }
+    }
+}
+
+// Deserialize a vector of block serializable elements as a view into the reader's buffer,
+// without allocating or copying. The data must be suitably aligned for T, and integers must not
+// be varint-encoded. The view is only valid while the buffer behind the BinaryReader is alive
 template<typename T>
-void deserialize(std::vector<T>& vec, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char *>(&size), sizeof(size_t)); // Read vector size
-    vec.resize(size);
-    for (auto& element : vec) {
-        deserialize(element, is); // Deserialize each element in the vector
+void deserialize(std::span<const T>& span, BinaryReader& is) {
+    static_assert(detail::block_copyable<T>, "only block serializable elements can be viewed in place");
+    if constexpr (detail::varint_encodable<T>) {
+        if (detail::varint_integers(is)) {
+            throw std::runtime_error("binary reader: varint-encoded integers cannot be viewed in place");
+        }
+    }
+    size_t size = detail::read_size(is); // Read span size
+    detail::check_count(is, size, sizeof(T));
+    const char* data = is.skip(size * sizeof(T));
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(T) != 0) {
+        throw std::runtime_error("binary reader: data is not aligned for an in-place view");
     }
+    span = std::span<const T>(reinterpret_cast<const T*>(data), size);
 }
 
 // Serialize std::pair to a binary stream
-template<typename K, typename V>
-void serialize(const std::pair<K, V>& pair, std::ostream& os) {
+template<typename K, typename V, typename Out>
+void serialize(const std::pair<K, V>& pair, Out& os) {
     serialize(pair.first, os); // Serialize first element of the pair
     serialize(pair.second, os); // Serialize second element of the pair
 }
 
 // Deserialize std::pair from a binary stream
-template<typename K, typename V>
-void deserialize(std::pair<K, V>& pair, std::istream& is) {
+template<typename K, typename V, typename In>
+void deserialize(std::pair<K, V>& pair, In& is) {
     deserialize(pair.first, is); // Deserialize first element of the pair
     deserialize(pair.second, is); // Deserialize second element of the pair
 }
 
 // Serialize std::map to a binary stream
-template<typename K, typename V>
-void serialize(const std::map<K, V>& map, std::ostream& os) {
+template<typename K, typename V, typename Out>
+void serialize(const std::map<K, V>& map, Out& os) {
     size_t size = map.size();
-    os.write(reinterpret_cast<const char *>(&size), sizeof(size_t)); // Write map size
+    detail::write_size(os, size); // Write map size
     for (const auto& element : map) {
         serialize(element, os); // Serialize each pair in the map
     }
 }
 
 // Deserialize std::map from a binary stream
-template<typename K, typename V>
-void deserialize(std::map<K, V>& map, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char *>(&size), sizeof(size_t)); // Read map size
+template<typename K, typename V, typename In>
+void deserialize(std::map<K, V>& map, In& is) {
+    size_t size = detail::read_size(is); // Read map size
+    detail::check_count(is, size, detail::min_serialized_size<std::pair<K, V>>::value);
     map.clear();
-    std::pair<K, V> element;
     for (size_t i = 0; i < size; i++) {
+        std::pair<K, V> element;
         deserialize(element, is); // Deserialize each pair in the map
-        map.insert(element); // Insert the pair into the map
+        // Entries were written in key order, so each one belongs at the end: hinted emplacement is O(1)
+        if (!map.empty() && !map.key_comp()(std::prev(map.end())->first, element.first)) {
+            throw std::runtime_error("map entries are not in strictly increasing key order");
+        }
+        map.emplace_hint(map.end(), std::move(element.first), std::move(element.second)); // Move the pair into the map
     }
 }
 
 // Serialize std::list to a binary stream
-template<typename T>
-void serialize(const std::list<T>& lst, std::ostream& os) {
+template<typename T, typename Out>
+void serialize(const std::list<T>& lst, Out& os) {
     size_t size = lst.size();
-    os.write(reinterpret_cast<const char *>(&size), sizeof(size_t)); // Write list size
+    detail::write_size(os, size); // Write list size
     for (const auto& element : lst) {
         serialize(element, os); // Serialize each element in the list
     }
 }
 
 // Deserialize std::list from a binary stream
-template<typename T>
-void deserialize(std::list<T>& lst, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char *>(&size), sizeof(size_t)); // Read list size
-    lst.resize(size);
-    for (auto& element : lst) {
-        deserialize(element, is); // Deserialize each element in the list
+template<typename T, typename In>
+void deserialize(std::list<T>& lst, In& is) {
+    size_t size = detail::read_size(is); // Read list size
+    detail::check_count(is, size, detail::min_serialized_size<T>::value);
+    lst.clear();
+    for (size_t i = 0; i < size; i++) {
+        deserialize(lst.emplace_back(), is); // Deserialize each element in the list
     }
 }
 
 // Serialize std::set to a binary stream
-template<typename T>
-void serialize(const std::set<T>& st, std::ostream& os) {
+template<typename T, typename Out>
+void serialize(const std::set<T>& st, Out& os) {
     size_t size = st.size();
-    os.write(reinterpret_cast<const char *>(&size), sizeof(size_t)); // Write set size
+    detail::write_size(os, size); // Write set size
     for (const auto& element : st) {
         serialize(element, os); // Serialize each element in the set
     }
 }
 
 // Deserialize std::set from a binary stream
-template<typename T>
-void deserialize(std::set<T>& st, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char *>(&size), sizeof(size_t)); // Read set size
+template<typename T, typename In>
+void deserialize(std::set<T>& st, In& is) {
+    size_t size = detail::read_size(is); // Read set size
+    detail::check_count(is, size, detail::min_serialized_size<T>::value);
+    st.clear();
     for (size_t i = 0; i < size; i++) {
         T element;
         deserialize(element, is); // Deserialize each element in the set
-        st.insert(element); // Insert element into the set
+        // Elements were written in order, so each one belongs at the end: hinted emplacement is O(1)
+        if (!st.empty() && !st.key_comp()(*std::prev(st.end()), element)) {
+            throw std::runtime_error("set elements are not in strictly increasing order");
+        }
+        st.emplace_hint(st.end(), std::move(element)); // Move the element into the set
     }
 }
 
-// Detect if a type has a member function `serialize(std::ostream&)`
-template<typename, typename = std::void_t<>>
+// Detect if a type has a member function `serialize(Out&)`, e.g. `serialize(std::ostream&)`
+template<typename, typename Out = std::ostream, typename = std::void_t<>>
 struct has_serialize : std::false_type {};
 
-template<typename T>
-struct has_serialize<T, std::void_t<decltype(std::declval<T>().serialize(std::declval<std::ostream&>()))>> : std::true_type {};
+template<typename T, typename Out>
+struct has_serialize<T, Out, std::void_t<decltype(std::declval<T>().serialize(std::declval<Out&>()))>> : std::true_type {};
 
-// Detect if a type has a member function `deserialize(std::istream&)`
-template<typename, typename = std::void_t<>>
+// Detect if a type has a member function `deserialize(In&)`, e.g. `deserialize(std::istream&)`
+template<typename, typename In = std::istream, typename = std::void_t<>>
 struct has_deserialize : std::false_type {};
 
-template<typename T>
-struct has_deserialize<T, std::void_t<decltype(std::declval<T>().deserialize(std::declval<std::istream&>()))>> : std::true_type {};
+template<typename T, typename In>
+struct has_deserialize<T, In, std::void_t<decltype(std::declval<T>().deserialize(std::declval<In&>()))>> : std::true_type {};
+
+// Detect if a type has a member function `serialized_size(const BinaryFormat&)` returning its exact encoded size
+template<typename, typename = std::void_t<>>
+struct has_serialized_size : std::false_type {};
 
-// Serialize user-defined types to a binary stream
 template<typename T>
-typename std::enable_if<has_serialize<T>::value, void>::type
-serialize(const T& value, std::ostream& os) {
-    value.serialize(os); // Call the user-defined serialize function
+struct has_serialized_size<T, std::void_t<decltype(std::declval<const T&>().serialized_size(std::declval<const BinaryFormat&>()))>> : std::true_type {};
+
+// Serialize user-defined types to a binary stream.
+// A type with a member template `serialize(Out&)` is written straight to a BinaryWriter, SizeCounter
+// or SpanWriter in its format. A type with only `serialize(std::ostream&)` is written to them through
+// a std::ostream over the sink, and so always in the default format.
+// When only counting bytes, a user-provided serialized_size is preferred over running serialize
+template<typename T, typename Out>
+typename std::enable_if<has_serialize<T, Out>::value || has_serialize<T>::value ||
+                        (std::is_same<Out, SizeCounter>::value && has_serialized_size<T>::value), void>::type
+serialize(const T& value, Out& os) {
+    if constexpr (std::is_same<Out, SizeCounter>::value && has_serialized_size<T>::value) {
+        os.add(value.serialized_size(os.format())); // Call the user-defined size function
+    } else if constexpr (has_serialize<T, Out>::value) {
+        value.serialize(os); // Call the user-defined serialize function
+    } else {
+        SinkStreambuf<Out> buffer(os);
+        std::ostream stream(&buffer);
+        value.serialize(stream); // Call the user-defined serialize function through a stream
+    }
 }
 
-// Deserialize user-defined types from a binary stream
-template<typename T>
-typename std::enable_if<has_deserialize<T>::value, void>::type
-deserialize(T& value, std::istream& is) {
-    value.deserialize(is); // Call the user-defined deserialize function
+// Deserialize user-defined types from a binary stream.
+// A type with only `deserialize(std::istream&)` is read from a BinaryReader through a std::istream over it
+template<typename T, typename In>
+typename std::enable_if<has_deserialize<T, In>::value ||
+                        (std::is_same<In, BinaryReader>::value && has_deserialize<T>::value), void>::type
+deserialize(T& value, In& is) {
+    if constexpr (has_deserialize<T, In>::value) {
+        value.deserialize(is); // Call the user-defined deserialize function
+    } else {
+        ReaderStreambuf buffer(is);
+        std::istream stream(&buffer);
+        value.deserialize(stream); // Call the user-defined deserialize function through a stream
+    }
 }
 
 // Serialize std::unique_ptr to a binary stream
-template<typename T>
-void serialize(const std::unique_ptr<T[]>& ptr, std::ostream& os, size_t size) {
+template<typename T, typename Out>
+void serialize(const std::unique_ptr<T[]>& ptr, Out& os, size_t size) {
     if (ptr) {
-        os.write(reinterpret_cast<const char*>(&size), sizeof(size_t)); // Write size of unique_ptr array
+        detail::write_size(os, size); // Write size of unique_ptr array
         os.write(reinterpret_cast<const char*>(ptr.get()), size * sizeof(T)); // Write array content
     } else {
         throw std::runtime_error("invalid unique_ptr for serialization");
@@ -185,20 +629,20 @@ void serialize(const std::unique_ptr<T[]>& ptr, std::ostream& os, size_t size) {
 }
 
 // Deserialize std::unique_ptr from a binary stream
-template<typename T>
-void deserialize(std::unique_ptr<T[]>& ptr, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char*>(&size), sizeof(size_t)); // Read size of unique_ptr array
+template<typename T, typename In>
+void deserialize(std::unique_ptr<T[]>& ptr, In& is) {
+    size_t size = detail::read_size(is); // Read size of unique_ptr array
+    detail::check_count(is, size, sizeof(T));
     ptr = std::make_unique<T[]>(size);
     ASSERT(ptr != nullptr, "unexpected error");
-    is.read(reinterpret_cast<char*>(ptr.get()), size * sizeof(T)); // Read array content
+    detail::read_raw(is, reinterpret_cast<char*>(ptr.get()), size * sizeof(T)); // Read array content
 }
 
 // Serialize std::shared_ptr to a binary stream
-template<typename T>
-void serialize(const std::shared_ptr<T[]>& ptr, std::ostream& os, size_t size) {
+template<typename T, typename Out>
+void serialize(const std::shared_ptr<T[]>& ptr, Out& os, size_t size) {
     if (ptr) {
-        os.write(reinterpret_cast<const char*>(&size), sizeof(size_t)); // Write size of shared_ptr array
+        detail::write_size(os, size); // Write size of shared_ptr array
         os.write(reinterpret_cast<const char*>(ptr.get()), size * sizeof(T)); // Write array content
     } else {
         throw std::runtime_error("invalid shared_ptr for serialization");
@@ -206,14 +650,72 @@ void serialize(const std::shared_ptr<T[]>& ptr, std::ostream& os, size_t size) {
 }
 
 // Deserialize std::shared_ptr from a binary stream
-template<typename T>
-void deserialize(std::shared_ptr<T[]>& ptr, std::istream& is) {
-    size_t size;
-    is.read(reinterpret_cast<char*>(&size), sizeof(size_t)); // Read size of shared_ptr array
+template<typename T, typename In>
+void deserialize(std::shared_ptr<T[]>& ptr, In& is) {
+    size_t size = detail::read_size(is); // Read size of shared_ptr array
+    detail::check_count(is, size, sizeof(T));
     ptr = std::shared_ptr<T[]>(new T[size]);
     ASSERT(ptr != nullptr, "unexpected error");
-    is.read(reinterpret_cast<char*>(ptr.get()), size * sizeof(T)); // Read array content
+    detail::read_raw(is, reinterpret_cast<char*>(ptr.get()), size * sizeof(T)); // Read array content
+}
+
+// Exact number of bytes serialize(value, ...) produces in the given format, computed without writing anything
+template<typename T>
+size_t serialized_size(const T& value, const BinaryFormat& format = BinaryFormat()) {
+    SizeCounter counter(format);
+    serialize(value, counter);
+    return counter.bytes_written();
+}
+
+// Exact number of bytes serialize(ptr, ..., size) produces for a unique_ptr array
+template<typename T>
+size_t serialized_size(const std::unique_ptr<T[]>& ptr, size_t size, const BinaryFormat& format = BinaryFormat()) {
+    SizeCounter counter(format);
+    serialize(ptr, counter, size);
+    return counter.bytes_written();
+}
+
+// Exact number of bytes serialize(ptr, ..., size) produces for a shared_ptr array
+template<typename T>
+size_t serialized_size(const std::shared_ptr<T[]>& ptr, size_t size, const BinaryFormat& format = BinaryFormat()) {
+    SizeCounter counter(format);
+    serialize(ptr, counter, size);
+    return counter.bytes_written();
+}
+
+// Serialize into caller-provided memory without any stream or heap involvement.
+// Returns the number of bytes used, or std::nullopt if `buffer` is too small
+template<typename T>
+std::optional<size_t> serialize_into(const T& value, std::span<std::byte> buffer, const BinaryFormat& format = BinaryFormat()) {
+    SpanWriter writer(buffer, format);
+    serialize(value, writer);
+    if (writer.overflowed()) {
+        return std::nullopt;
+    }
+    return writer.bytes_written();
+}
+
+// Serialize a unique_ptr array into caller-provided memory
+template<typename T>
+std::optional<size_t> serialize_into(const std::unique_ptr<T[]>& ptr, size_t size, std::span<std::byte> buffer, const BinaryFormat& format = BinaryFormat()) {
+    SpanWriter writer(buffer, format);
+    serialize(ptr, writer, size);
+    if (writer.overflowed()) {
+        return std::nullopt;
+    }
+    return writer.bytes_written();
+}
+
+// Serialize a shared_ptr array into caller-provided memory
+template<typename T>
+std::optional<size_t> serialize_into(const std::shared_ptr<T[]>& ptr, size_t size, std::span<std::byte> buffer, const BinaryFormat& format = BinaryFormat()) {
+    SpanWriter writer(buffer, format);
+    serialize(ptr, writer, size);
+    if (writer.overflowed()) {
+        return std::nullopt;
+    }
+    return writer.bytes_written();
 }
 
 
-};
\ No newline at end of file
+};
@@ -41,6 +41,15 @@ distribution.
 #   include <cstring>
 #endif
 #include <stdint.h>
+#if defined(__has_include)
+#   if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#       include <charconv>
+#   endif
+#endif
+#if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+    // Integer and floating point std::to_chars/std::from_chars are both available
+#   define TIXML_USE_CHARCONV
+#endif
 
 /*
 	gcc:
@@ -455,6 +464,56 @@ private:
 };
 
 
+/*
+	The distinct element and attribute names of a document, each
+	stored once. Every name a document gives a node goes through
+	its table, so two nodes of the same document have the same
+	name exactly when their name pointers are equal.
+*/
+class TINYXML2_LIB NameTable
+{
+public:
+    NameTable();
+    ~NameTable();
+
+    // The stored copy of name, added if it is new
+    const char* Intern( const char* name );
+    // The stored copy of name, or null if no node was ever given that name
+    const char* Find( const char* name ) const;
+    // Forget every name but keep the memory for the next ones
+    void Reset();
+    void Clear();
+
+    int Size() const {
+        return _size;
+    }
+
+private:
+    NameTable( const NameTable& );	// not supported
+    void operator=( const NameTable& );	// not supported
+
+    struct Entry {
+        const char* name;
+        size_t      length;
+        unsigned    hash;
+    };
+    enum { BLOCK_SIZE = 4096 };
+
+    static unsigned Hash( const char* name, size_t* length );
+    Entry* Lookup( const char* name, size_t length, unsigned hash ) const;
+    char* Store( const char* name, size_t length );
+    void Grow();
+
+    Entry*  _entries;		// open addressing, _capacity is a power of 2
+    int     _capacity;
+    int     _size;
+    DynArray< char*, 10 > _blockPtrs;	// blocks of BLOCK_SIZE
+    DynArray< char*, 10 > _longNames;	// names stored on their own
+    int     _block;			// index of the block being filled, or -1
+    size_t  _blockUsed;
+};
+
+
 
 /**
 	Implements the interface to the "Visitor pattern" (see the Accept() method.)
@@ -972,6 +1031,7 @@ private:
     void Unlink( XMLNode* child );
     static void DeleteNode( XMLNode* node );
     void InsertChildPreamble( XMLNode* insertThis ) const;
+    // name is null or interned by this node's document
     const XMLElement* ToElementWithName( const char* name ) const;
 
     XMLNode( const XMLNode& );	// not supported
@@ -1248,6 +1308,7 @@ private:
 
     XMLAttribute( const XMLAttribute& );	// not supported
     void operator=( const XMLAttribute& );	// not supported
+    // name is interned by the document of the attribute's element
     void SetName( const char* name );
 
     char* ParseDeep( char* p, bool processEntities, int* curLineNumPtr );
@@ -1773,6 +1834,23 @@ public:
     */
     XMLError LoadFile( FILE* );
 
+    /**
+    	Load an XML file from disk by mapping it copy-on-write and
+    	parsing it in place, instead of reading it into a heap buffer.
+    	Pages are read on demand as the parser reaches them, and only
+    	the pages the document writes to (string terminators, decoded
+    	entities) are ever copied.
+
+    	The file must not be truncated or rewritten while the document
+    	still refers to it, so this is meant for documents that are
+    	read, not saved back over their own file. On platforms without
+    	mmap it is the same as LoadFile().
+
+    	Returns XML_SUCCESS (0) on success, or
+    	an errorID.
+    */
+    XMLError LoadMappedFile( const char* filename );
+
     /**
     	Save the XML file to disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1796,6 +1874,30 @@ public:
         return _whitespaceMode;
     }
 
+    /**
+    	Normally the names, values and text of a parsed document are
+    	decoded (entities, newlines, whitespace collapsing) in place
+    	the first time they are read, so even const access writes to
+    	the document. With this option set, Parse() and the LoadFile()
+    	family decode every string before they return instead. A
+    	document parsed that way is not modified by const access and
+    	can be read from several threads at once without locking, as
+    	long as no thread changes it.
+
+    	@verbatim
+    	XMLDocument doc;
+    	doc.SetNormalizeOnParse( true );
+    	doc.LoadFile( "shared.xml" );
+    	// const XMLDocument& may now be handed to worker threads
+    	@endverbatim
+    */
+    void SetNormalizeOnParse( bool normalize ) {
+        _normalizeOnParse = normalize;
+    }
+    bool NormalizeOnParse() const {
+        return _normalizeOnParse;
+    }
+
     /**
     	Returns true if this document has a leading Byte Order Mark of UTF8.
     */
@@ -1909,6 +2011,17 @@ public:
     /// Clear the document, resetting it to the initial state.
     void Clear();
 
+    /**
+    	Delete the content of the document like Clear(), but keep the
+    	memory it has allocated for the next one: the blocks of the
+    	node pools, the buffer the text is parsed in and the name
+    	table. Parse() and the LoadFile() family start with a Reset(),
+    	so a document reused for inputs of similar size stops
+    	allocating once it has seen the largest. Clear() gives the
+    	buffer and the name table back.
+    */
+    void Reset();
+
 	/**
 		Copies this document to a target document.
 		The target will be completely cleared before the copy.
@@ -1924,6 +2037,15 @@ public:
 	// internal
 	void MarkInUse(const XMLNode* const);
 
+	// internal: the document's single copy of an element or attribute name
+    const char* InternName( const char* name ) {
+        return _names.Intern( name );
+    }
+    // internal: as InternName(), or null if no node of the document was ever given that name
+    const char* FindName( const char* name ) const {
+        return _names.Find( name );
+    }
+
     virtual XMLNode* ShallowClone( XMLDocument* /*document*/ ) const override{
         return 0;
     }
@@ -1937,11 +2059,14 @@ private:
 
     bool			_writeBOM;
     bool			_processEntities;
+    bool			_normalizeOnParse;
     XMLError		_errorID;
     Whitespace		_whitespaceMode;
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    size_t			_charBufferSize;	// capacity of a _charBuffer allocated with new[], kept across Reset()
+    size_t			_mappedSize;	// length of the mapping _charBuffer points to, or 0 if it was allocated with new[]
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1956,10 +2081,14 @@ private:
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
     MemPoolT< sizeof(XMLText) >		 _textPool;
     MemPoolT< sizeof(XMLComment) >	 _commentPool;
+    NameTable						 _names;
 
 	static const char* _errorNames[XML_ERROR_COUNT];
 
     void Parse();
+    void NormalizeStrings();
+    void ReserveCharBuffer( size_t size );
+    void FreeCharBuffer();
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
@@ -1998,6 +2127,92 @@ inline NodeType* XMLDocument::CreateUnlinkedNode( MemPoolT<PoolElementSize>& poo
     return returnNode;
 }
 
+/**
+	A forward-only pull parser. Where XMLDocument builds the whole tree before
+	anything can be read, XMLPullParser scans its buffer on demand with the same
+	StrPair and XMLUtil code and reports what it finds one event at a time,
+	allocating no nodes:
+
+	@verbatim
+	<a x="1">text<b/></a>
+	@endverbatim
+
+	yields START_ELEMENT a, ATTRIBUTE x, TEXT, START_ELEMENT b, END_ELEMENT b,
+	END_ELEMENT a and finally END_DOCUMENT. Attributes always come straight after
+	the START_ELEMENT of their element. Whitespace-only text between tags,
+	declarations, comments and DTDs are skipped; CDATA is reported as TEXT.
+
+	Strings are decoded in place when Name() or Value() is called, and stay valid
+	only until the next call to Next().
+*/
+class TINYXML2_LIB XMLPullParser
+{
+public:
+    enum Event {
+        START_ELEMENT,
+        ATTRIBUTE,
+        TEXT,
+        END_ELEMENT,
+        END_DOCUMENT,
+        PARSE_ERROR
+    };
+
+    XMLPullParser( bool processEntities = true );
+    ~XMLPullParser();
+
+    /// Load an XML file into the parser's buffer. Returns XML_SUCCESS (0) on success, or an errorID.
+    XMLError LoadFile( const char* filename );
+    /// Load an open file into the parser's buffer.
+    XMLError LoadFile( FILE* );
+    /// Copy nBytes of xml (all of it if nBytes is -1) into the parser's buffer.
+    XMLError Parse( const char* xml, size_t nBytes=static_cast<size_t>(-1) );
+
+    /// Scan to the next event. PARSE_ERROR and END_DOCUMENT are returned for every later call too.
+    Event Next();
+    Event CurrentEvent() const			{ return _event; }
+
+    /// The element name for START_ELEMENT and END_ELEMENT, or the attribute name for ATTRIBUTE.
+    const char* Name();
+    /// The attribute value for ATTRIBUTE, or the text for TEXT.
+    const char* Value();
+    /// Number of open elements, counting the one a START_ELEMENT or END_ELEMENT event is about.
+    int Depth() const					{ return _depth; }
+    int LineNum() const					{ return _lineNum; }
+
+    XMLError ErrorID() const			{ return _errorID; }
+    bool Error() const					{ return _errorID != XML_SUCCESS; }
+
+private:
+    XMLPullParser( const XMLPullParser& );	// not supported
+    void operator=( const XMLPullParser& );	// not supported
+
+    void Reset();
+    void AllocateBuffer( size_t size );
+    void Start();
+    Event Fail( XMLError error );
+    Event ParseAttribute( char* p );
+    Event ParseContent();
+    // Remember the character a string's terminator will overwrite, to put it back before scanning on.
+    void Protect( char* end );
+
+    bool		_processEntities;
+    char*		_charBuffer;
+    char*		_p;
+    Event		_event;
+    XMLError	_errorID;
+    int			_lineNum;
+    int			_depth;
+    bool		_inTag;			// attributes of the open start tag have not all been read
+    StrPair		_name;
+    StrPair		_value;
+    char*		_protected[2];
+    char		_protectedChar[2];
+    int			_protectedCount;
+    // start and end of the name of every open element
+    DynArray<char*, 20> _open;
+};
+
+
 /**
 	A XMLHandle is a class that wraps a node pointer with null checks; this is
 	an incredibly useful thing. Note that XMLHandle is not part of the TinyXML-2
@@ -2248,7 +2463,29 @@ public:
     	with only required whitespace and newlines.
     */
     XMLPrinter( FILE* file=0, bool compact = false, int depth = 0 );
-    virtual ~XMLPrinter()	{}
+    virtual ~XMLPrinter();
+
+    /**
+    	If printing to a FILE*, collect output in an internal buffer
+    	and hand it to the file in large chunks. Off by default, so
+    	everything printed is in the FILE* straight away. While it
+    	is on, call Flush() before closing, reading or writing to
+    	the FILE* while the printer is still alive.
+    */
+    void SetBuffered( bool buffered );
+    /**
+    	If buffering, pass everything buffered so far on to the
+    	file. Called on destruction.
+    */
+    void Flush();
+    /**
+    	If buffering, write flushed chunks with write(2) on the
+    	file's descriptor instead of going through stdio.
+    	Ignored where write(2) is not available.
+    */
+    void SetDirectWrite( bool direct )	{ _directWrite = direct; }
+    /// True if handing output to the FILE* has failed.
+    bool WriteError() const				{ return _writeError; }
 
     /** If streaming, write the BOM and declaration. */
     void PushHeader( bool writeBOM, bool writeDeclaration );
@@ -2352,9 +2589,14 @@ private:
      */
     void PrepareForNewNode( bool compactMode );
     void PrintString( const char*, bool restrictedEntitySet );	// prints out, after detecting entities.
+    void WriteFile( const char* data, size_t size );	// hands data straight to the FILE*
 
     bool _firstElement;
     FILE* _fp;
+    char* _fileBuffer;
+    size_t _fileBufferUsed;
+    bool _directWrite;
+    bool _writeError;
     int _depth;
     int _textDepth;
     bool _processEntities;
@@ -2362,7 +2604,8 @@ private:
 
     enum {
         ENTITY_RANGE = 64,
-        BUF_SIZE = 200
+        BUF_SIZE = 200,
+        FILE_BUFFER_SIZE = 64 * 1024
     };
     bool _entityFlag[ENTITY_RANGE];
     bool _restrictedEntityFlag[ENTITY_RANGE];
@@ -6,11 +6,15 @@
 #include <list>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <type_traits>
 #include <memory>
 #include <cassert>
-#include <sstream>
+#include <limits>
+#include <cerrno>
+#include <iterator>
 #include "tinyxml2.h"
+#include "base64.hpp"
 
 
 #define ASSERT(expr, message) assert((expr) && (message))
@@ -20,86 +24,418 @@ using namespace tinyxml2;
 
 namespace XMLSerialization{
 
-// Serialize function for arithmetic types (excluding char)
+// Parse an attribute value into an arithmetic type through tinyxml2's locale-free number parsing,
+// which accepts the same hex and bool spellings as the Query*Value functions.
+// Returns false for a missing, malformed or out of range value
 template<typename T>
-typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, void>::type
-serialize_xml(const T& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization = nullptr;
-
-    // Load the XML file, if it does not exist, create a new one
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
+bool parse_value(const char* str, T& value) {
+    if (!str) {
+        return false;
+    }
+    if constexpr (std::is_same<T, bool>::value) {
+        return XMLUtil::ToBool(str, &value);
+    } else if constexpr (std::is_same<T, float>::value) {
+        return XMLUtil::ToFloat(str, &value);
+    } else if constexpr (std::is_floating_point<T>::value) {
+        double v;
+        if (!XMLUtil::ToDouble(str, &v)) {
+            return false;
+        }
+        value = static_cast<T>(v);
+        return true;
+    } else if constexpr (std::is_signed<T>::value) {
+        int64_t v;
+        if (!XMLUtil::ToInt64(str, &v) || v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) {
+            return false;
+        }
+        value = static_cast<T>(v);
+        return true;
+    } else {
+        uint64_t v;
+        if (!XMLUtil::ToUnsigned64(str, &v) || v > std::numeric_limits<T>::max()) {
+            return false;
+        }
+        value = static_cast<T>(v);
+        return true;
+    }
+}
+
+// Options controlling how an XMLArchive lays out the values it writes.
+// Reading accepts either layout regardless of the options
+struct XMLFormat {
+    // Write arithmetic std::vector/std::list/std::set contents as a single element whose text is
+    // a space-separated run of numbers, instead of one <element val="..."/> node per item
+    bool packed_numbers = false;
+
+    // Write arithmetic std::vector contents and unique_ptr/shared_ptr arrays as the base64 text of their
+    // raw bytes, declaring the element type and count. Takes precedence over packed_numbers
+    bool base64_blobs = false;
+};
+
+// Documents handed from one archive to the next on the same thread.
+// A released document is Reset(), which keeps its node pool blocks, parse buffer and name table,
+// so opening archive after archive, as the filename overloads of serialize_xml/deserialize_xml do,
+// stops allocating for the document once the pool has seen the largest file
+class XMLDocumentPool {
+public:
+    // Documents kept per thread; any released beyond this are destroyed
+    static constexpr size_t capacity = 4;
+
+    // A document in its initial state, taken from this thread's pool if it has one
+    static std::unique_ptr<XMLDocument> acquire() {
+        auto* docs = documents();
+        if (!docs || docs->empty()) {
+            return std::make_unique<XMLDocument>();
+        }
+        std::unique_ptr<XMLDocument> doc = std::move(docs->back());
+        docs->pop_back();
+        return doc;
+    }
+
+    static void release(std::unique_ptr<XMLDocument> doc) {
+        auto* docs = documents();
+        if (!doc || !docs || docs->size() >= capacity) {
+            return;
+        }
+        doc->Reset();
+        doc->SetBOM(false);
+        doc->SetNormalizeOnParse(false);
+        docs->push_back(std::move(doc));
+    }
+
+    // Destroy this thread's pooled documents, giving their memory back
+    static void clear() {
+        if (auto* docs = documents()) {
+            docs->clear();
+        }
+    }
+
+private:
+    struct Documents {
+        std::vector<std::unique_ptr<XMLDocument>> docs;
+        ~Documents() { exited() = true; }
+    };
+
+    static bool& exited() {
+        thread_local bool flag = false;
+        return flag;
+    }
+
+    // This thread's pool, or nullptr once it has been destroyed at thread exit,
+    // where archives with static storage may still be released
+    static std::vector<std::unique_ptr<XMLDocument>>* documents() {
+        if (exited()) {
+            return nullptr;
+        }
+        thread_local Documents pool;
+        return &pool.docs;
+    }
+};
+
+// An XML document kept open across many serialize_xml/deserialize_xml calls.
+// The file is parsed once on construction; every call works on the in-memory document,
+// and the document is written back once, on commit() or destruction.
+class XMLArchive {
+public:
+    enum Mode {
+        READ,   // the file must exist; the document is never written back
+        UPDATE, // the file is created if missing; changes are saved on commit or destruction
+        SHARED, // as READ, but everything is decoded and indexed while loading, so any number of
+                // threads may deserialize from the archive at once
+        MAPPED  // as READ, but the file is mapped and parsed in place instead of being read into memory.
+                // The file must not change while the archive is alive: nothing, including an UPDATE archive
+                // or serialize_xml on the same file, may rewrite or truncate it, or reads can see the new
+                // bytes or fault
+    };
+
+    explicit XMLArchive(const std::string& filename, Mode mode = UPDATE, XMLFormat format = {})
+        : filename_(filename), mode_(mode), format_(format), doc_(XMLDocumentPool::acquire()) {
+        doc_->SetNormalizeOnParse(mode_ == SHARED);
+        XMLError loaded = mode_ == MAPPED ? doc_->LoadMappedFile(filename_.c_str()) : doc_->LoadFile(filename_.c_str());
+        if (loaded != XML_SUCCESS) {
+            if (mode_ != UPDATE) {
+                throw std::runtime_error("file open error");
+            }
+            doc_->Reset();
+        }
+        root_ = doc_->FirstChildElement("serialization"); // try to find the root element <serialization><\serialization>
+        if (!root_ && mode_ == UPDATE) { // insert the root element
+            root_ = doc_->NewElement("serialization");
+            doc_->InsertFirstChild(root_);
+            dirty_ = true;
+        }
+        if (root_ && mode_ == SHARED) {
+            build_index(); // find() must not write to the archive either
+        }
+    }
+
+    XMLArchive(const XMLArchive&) = delete;
+    XMLArchive& operator=(const XMLArchive&) = delete;
+
+    // Pending changes are saved on destruction; errors can only be observed through an explicit commit().
+    // The document then goes back to this thread's XMLDocumentPool
+    ~XMLArchive() {
+        try {
+            commit();
+        } catch (...) {
+        }
+        XMLDocumentPool::release(std::move(doc_));
+    }
+
+    // Write the document back to its file if anything changed since the last commit
+    void commit() {
+        if (mode_ == UPDATE && dirty_) {
+            if (doc_->SaveFile(filename_.c_str()) != XML_SUCCESS) {
+                throw std::runtime_error("file save error");
+            }
+            dirty_ = false;
+        }
+    }
+
+    XMLDocument& document() { return *doc_; }
+
+    const XMLFormat& format() const { return format_; }
+    void set_format(const XMLFormat& format) { format_ = format; }
+
+    // The root element <serialization>, or nullptr if a read-only archive has none
+    XMLElement* root() { return root_; }
+
+    // Find the first top-level entry with the given name.
+    // Lookups go through a name index built on first use, so reading back many entries stays linear
+    XMLElement* find(const std::string& name) {
+        if (!root_) {
+            throw std::runtime_error("fail to find serialization element.");
+        }
+        if (!indexed_) {
+            build_index();
+        }
+        auto it = index_.find(name);
+        return it == index_.end() ? nullptr : it->second;
+    }
+
+    // Add a top-level entry before / after all existing ones, keeping the name index in step
+    void insert_first(XMLElement* element) {
+        root_->InsertFirstChild(element);
+        if (indexed_) {
+            index_[element->Name()] = element; // the new entry now comes first
+        }
+        dirty_ = true;
+    }
+
+    void insert_last(XMLElement* element) {
+        root_->InsertEndChild(element);
+        if (indexed_) {
+            index_.emplace(element->Name(), element); // an earlier entry of the same name still wins
+        }
+        dirty_ = true;
+    }
+
+private:
+    // Map each entry name to its first element under the root, as FirstChildElement would find it.
+    // Entries added or removed through document() directly are not tracked
+    void build_index() {
+        for (XMLElement* element = root_->FirstChildElement(); element; element = element->NextSiblingElement()) {
+            index_.emplace(element->Name(), element);
+        }
+        indexed_ = true;
+    }
+
+    std::string filename_;
+    Mode mode_;
+    XMLFormat format_;
+    std::unique_ptr<XMLDocument> doc_;
+    XMLElement* root_ = nullptr;
+    bool dirty_ = false;
+    std::unordered_map<std::string, XMLElement*> index_;
+    bool indexed_ = false;
+};
+
+// Element types that a container may write as a packed run of numbers.
+// bool and char keep their per-item form, since their attribute text is not a number
+template<typename T>
+inline constexpr bool packable_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>;
+
+// Print the text XMLElement::SetAttribute would give an arithmetic value
+template<typename T>
+void value_text(const T& value, char* buffer, int size) {
+    if constexpr (std::is_same_v<T, bool>) XMLUtil::ToStr(value, buffer, size);
+    else if constexpr (std::is_same_v<T, float>) XMLUtil::ToStr(value, buffer, size);
+    else if constexpr (std::is_floating_point_v<T>) XMLUtil::ToStr(static_cast<double>(value), buffer, size);
+    else if constexpr (std::is_signed_v<T>) XMLUtil::ToStr(static_cast<int64_t>(value), buffer, size);
+    else XMLUtil::ToStr(static_cast<uint64_t>(value), buffer, size);
+}
+
+// Set the text of a container element to the space-separated values of [first, last),
+// printed as value_text prints a single value
+template<typename It>
+void write_packed(XMLElement* element, It first, It last) {
+    std::string text;
+    char buffer[64];
+    for (; first != last; ++first) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        value_text(*first, buffer, sizeof(buffer));
+        text.append(buffer);
+    }
+    if (!text.empty()) {
+        element->SetText(text.c_str());
+    }
+}
+
+// A container element holds a packed run if it has text and no per-item children
+inline bool is_packed(const XMLElement* element) {
+    return !element->FirstChildElement() && element->GetText();
+}
+
+// Parse the number of a packed run that starts at cur, returning where it ends,
+// or nullptr if it is malformed or out of range for T
+template<typename T>
+const char* parse_packed_value(const char* cur, const char* end, T& value) {
+#if defined(TIXML_USE_CHARCONV)
+    auto result = std::from_chars(cur, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+    // Without floating point from_chars, fall back to the C conversions. The text is null terminated
+    (void)end;
+    char* next = nullptr;
+    errno = 0;
+    if constexpr (std::is_same_v<T, float>) {
+        value = strtof(cur, &next);
+    } else if constexpr (std::is_same_v<T, double>) {
+        value = strtod(cur, &next);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        value = strtold(cur, &next);
+    } else if constexpr (std::is_signed_v<T>) {
+        long long v = strtoll(cur, &next, 10);
+        if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) {
+            return nullptr;
+        }
+        value = static_cast<T>(v);
     } else {
-        serialization = doc.FirstChildElement("serialization");
-        if (!serialization) {
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
+        if (*cur == '-') {
+            return nullptr;
+        }
+        unsigned long long v = strtoull(cur, &next, 10);
+        if (v > std::numeric_limits<T>::max()) {
+            return nullptr;
         }
+        value = static_cast<T>(v);
     }
+    return next != cur && errno != ERANGE ? next : nullptr;
+#endif
+}
+
+// Parse the text of a packed run in one pass, storing each value through out
+template<typename T, typename OutputIt>
+void read_packed(const char* text, OutputIt out) {
+    const char* cur = text;
+    const char* end = cur + strlen(cur);
+    while (true) {
+        while (cur != end && XMLUtil::IsWhiteSpace(*cur)) {
+            ++cur;
+        }
+        if (cur == end) {
+            break;
+        }
+        T value;
+        const char* next = parse_packed_value(cur, end, value);
+        if (!next || (next != end && !XMLUtil::IsWhiteSpace(*next))) {
+            throw std::runtime_error("parsing packed value error");
+        }
+        *out++ = value;
+        cur = next;
+    }
+}
+
+// The element type a blob declares, e.g. "int32" or "float64"
+template<typename T>
+std::string blob_type() {
+    const char* kind = std::is_floating_point_v<T> ? "float" : std::is_signed_v<T> ? "int" : "uint";
+    return kind + std::to_string(sizeof(T) * 8);
+}
+
+// Store count values as the base64 text of their bytes, in the machine's byte order like the binary format.
+// The element type and count are declared as attributes so a reader can size and check the buffer up front
+template<typename T>
+void write_blob(XMLElement* element, const T* data, size_t count) {
+    element->SetAttribute("encoding", "base64");
+    element->SetAttribute("type", blob_type<T>().c_str());
+    element->SetAttribute("count", static_cast<uint64_t>(count));
+    if (count) {
+        element->SetText(base64::encode(data, count * sizeof(T)).c_str());
+    }
+}
+
+inline bool is_blob(const XMLElement* element) {
+    return element->Attribute("encoding", "base64") != nullptr;
+}
+
+// The count a blob declares through its type and count attributes, after checking that it holds values of type T
+template<typename T>
+size_t blob_count(const char* type, const char* count) {
+    uint64_t value = 0;
+    if (!type || blob_type<T>() != type) {
+        throw std::runtime_error("blob element type mismatch");
+    }
+    if (!count || !XMLUtil::ToUnsigned64(count, &value) || value > SIZE_MAX / sizeof(T)) {
+        throw std::runtime_error("blob count error");
+    }
+    return static_cast<size_t>(value);
+}
+
+// Decode the text of a blob into data, which holds the count values blob_count returned
+template<typename T>
+void read_blob(const char* text, T* data, size_t count) {
+    if (!text) {
+        text = "";
+    }
+    size_t length = strlen(text);
+    if (base64::decoded_size(text, length) != count * sizeof(T) || !base64::decode(text, length, data)) {
+        throw std::runtime_error("blob decoding error");
+    }
+}
+
+// Serialize function for arithmetic types (excluding char)
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, void>::type
+serialize_xml(const T& value, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
     
     // Create a new element with the provided name and set its value attribute
     XMLElement* arithmetic = doc.NewElement(name.c_str());
     arithmetic->SetAttribute("val", value);
-    serialization->InsertEndChild(arithmetic);
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(arithmetic);
 }
 
 // Serialize function for char type
 template<typename T>
 typename std::enable_if<std::is_same<T, char>::value, void>::type
-serialize_xml(const T& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization = nullptr;
-
-    // Load the XML file, if it does not exist, create a new one
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    } else {
-        serialization = doc.FirstChildElement("serialization");
-        if (!serialization) {
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+serialize_xml(const T& value, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
     
     // Create a new element with the provided name and set its value attribute as a string of length 1
     XMLElement* charElement = doc.NewElement(name.c_str());
     charElement->SetAttribute("val", std::string(1, value).c_str());
-    serialization->InsertEndChild(charElement);
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(charElement);
 }
 
 // Deserialize function for arithmetic types (excluding char)
 template<typename T>
 typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, void>::type
-deserialize_xml(T& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-
-    // Load the XML file, throw an error if it cannot be opened
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("File open error");
-    }
-
-    // Locate the serialization element, throw an error if not found
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-    if (!serialization) {
-        throw std::runtime_error("Serialization element not found.");
-    } 
-
+deserialize_xml(T& value, const std::string& name, XMLArchive& archive) {
     // Locate the specific element by name and retrieve its value attribute
-    XMLElement* arithmetic = serialization->FirstChildElement(name.c_str());
+    XMLElement* arithmetic = archive.find(name);
+    if (!arithmetic) {
+        throw std::runtime_error("Element not found.");
+    }
     const char* val = arithmetic->Attribute("val");
     if (!val) {
         throw std::runtime_error("Value retrieval error");
     }
 
     // Convert the string attribute value to the appropriate type
-    std::stringstream ss(val);
-    ss >> value;
-    if (ss.fail()) {
+    if (!parse_value(val, value)) {
         throw std::runtime_error("Parsing attribute value error.");
     }
 }
@@ -107,22 +443,12 @@ deserialize_xml(T& value, const std::string& name, const std::string& filename)
 // Deserialize function for char type
 template<typename T>
 typename std::enable_if<std::is_same<T, char>::value, void>::type
-deserialize_xml(T& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-
-    // Load the XML file, throw an error if it cannot be opened
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("File open error");
-    }
-
-    // Locate the serialization element, throw an error if not found
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-    if (!serialization) {
-        throw std::runtime_error("Serialization element not found.");
-    } 
-
+deserialize_xml(T& value, const std::string& name, XMLArchive& archive) {
     // Locate the specific element by name and retrieve its value attribute
-    XMLElement* charElement = serialization->FirstChildElement(name.c_str());
+    XMLElement* charElement = archive.find(name);
+    if (!charElement) {
+        throw std::runtime_error("Element not found.");
+    }
     const char* val = charElement->Attribute("val");
     if (!val) {
         throw std::runtime_error("Value retrieval error");
@@ -139,69 +465,46 @@ deserialize_xml(T& value, const std::string& name, const std::string& filename)
 
 
 // serialize for string
-void serialize_xml(const std::string& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) { // if the file does not exist, we need to insert the root element <serialization><\serialization>
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization"); // try to find the root element <serialization><\serialization>
-        if (!serialization) { // insert the root element
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+inline void serialize_xml(const std::string& value, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // create the new element
     XMLElement* String = doc.NewElement(name.c_str());
     String->SetAttribute("val", value.c_str());
-    serialization->InsertEndChild(String);
-
-    // save the contents in to the file
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(String);
 }
 
 // deserialize for string
-void deserialize_xml (std::string& value, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-
-    // if the file does not exist, return
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("file open error");
-    }
-
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-    if (!serialization) {
-        throw std::runtime_error("fail to find serialization element.");
-    } 
-
+inline void deserialize_xml (std::string& value, const std::string& name, XMLArchive& archive) {
     // find the first matched element
-    XMLElement* String = serialization->FirstChildElement(name.c_str());
+    XMLElement* String = archive.find(name);
+    if (!String) {
+        throw std::runtime_error("fail to find the serialization element");
+    }
     value = String->Attribute("val");
 }
 
 // serialize for vector
 template<typename T>
-void serialize_xml(const std::vector<T>& vec, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) { // if the file does not exist
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization"); // try to find the root element <serialization><\serialization>
-        if (!serialization) { // insert the root element
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+void serialize_xml(const std::vector<T>& vec, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // create a new element for vector
     XMLElement* std_vector = doc.NewElement(name.c_str());
 
+    if constexpr (packable_v<T>) {
+        if (archive.format().base64_blobs) {
+            write_blob(std_vector, vec.data(), vec.size());
+            archive.insert_first(std_vector);
+            return;
+        }
+        if (archive.format().packed_numbers) {
+            write_packed(std_vector, vec.begin(), vec.end());
+            archive.insert_first(std_vector);
+            return;
+        }
+    }
+
     // create elements for the vector's contents
     for (const auto& element : vec) {
         XMLElement* xml_element = doc.NewElement("element");
@@ -211,31 +514,33 @@ void serialize_xml(const std::vector<T>& vec, const std::string& name, const std
         std_vector->InsertEndChild(xml_element);
     }
 
-    serialization->InsertFirstChild(std_vector);
-
-    doc.SaveFile(filename.c_str());
+    archive.insert_first(std_vector);
 }
 
 
 // deserialize for vector
 template<typename T>
-void deserialize_xml(std::vector<T>& vec, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("file open error");
-    }
-
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-
-    XMLElement* std_vec;
-    std_vec = serialization->FirstChildElement(name.c_str());
+void deserialize_xml(std::vector<T>& vec, const std::string& name, XMLArchive& archive) {
+    XMLElement* std_vec = archive.find(name);
     if (!std_vec) {
         throw std::runtime_error("fail to find the serialization element");
     }
 
     // clear the vector
     vec.resize(0);
-    
+
+    if constexpr (packable_v<T>) {
+        if (is_blob(std_vec)) {
+            vec.resize(blob_count<T>(std_vec->Attribute("type"), std_vec->Attribute("count")));
+            read_blob(std_vec->GetText(), vec.data(), vec.size());
+            return;
+        }
+        if (is_packed(std_vec)) {
+            read_packed<T>(std_vec->GetText(), std::back_inserter(vec));
+            return;
+        }
+    }
+
     T value;
     for (XMLElement* xml_element = std_vec->FirstChildElement("element"); xml_element; xml_element = xml_element->NextSiblingElement()) {
         const char* val = xml_element->Attribute("val");
@@ -243,9 +548,7 @@ void deserialize_xml(std::vector<T>& vec, const std::string& name, const std::st
             throw std::runtime_error("get value error");
         }
         if constexpr (std::is_arithmetic_v<T>) {
-            std::stringstream ss(val);
-            ss >> value;
-            if (ss.fail()) {
+            if (!parse_value(val, value)) {
                 throw std::runtime_error("parsing attribute value error");
             }
         }
@@ -258,24 +561,20 @@ void deserialize_xml(std::vector<T>& vec, const std::string& name, const std::st
 
 // serialize for list
 template<typename T>
-void serialize_xml(const std::list<T>& lst, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) { // if the file does not exist
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization"); // try to find the root element <serialization><\serialization>
-        if (!serialization) { // insert the root element
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+void serialize_xml(const std::list<T>& lst, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // create a new element for list
     XMLElement* std_list = doc.NewElement(name.c_str());
 
+    if constexpr (packable_v<T>) {
+        if (archive.format().packed_numbers) {
+            write_packed(std_list, lst.begin(), lst.end());
+            archive.insert_first(std_list);
+            return;
+        }
+    }
+
     // create elements for the list's contents
     for (const auto& element : lst) {
         XMLElement* xml_element = doc.NewElement("element");
@@ -285,31 +584,28 @@ void serialize_xml(const std::list<T>& lst, const std::string& name, const std::
         std_list->InsertEndChild(xml_element);
     }
 
-    serialization->InsertFirstChild(std_list);
-
-    doc.SaveFile(filename.c_str());
+    archive.insert_first(std_list);
 }
 
 
 // deserialize for list
 template<typename T>
-void deserialize_xml(std::list<T>& lst, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("file open error");
-    }
-
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-
-    XMLElement* std_list;
-    std_list = serialization->FirstChildElement(name.c_str());
+void deserialize_xml(std::list<T>& lst, const std::string& name, XMLArchive& archive) {
+    XMLElement* std_list = archive.find(name);
     if (!std_list) {
         throw std::runtime_error("fail to find the serialization element");
     }
 
     // clear the list
     lst.resize(0);
-    
+
+    if constexpr (packable_v<T>) {
+        if (is_packed(std_list)) {
+            read_packed<T>(std_list->GetText(), std::back_inserter(lst));
+            return;
+        }
+    }
+
     T value;
     for (XMLElement* xml_element = std_list->FirstChildElement("element"); xml_element; xml_element = xml_element->NextSiblingElement()) {
         const char* val = xml_element->Attribute("val");
@@ -317,9 +613,7 @@ void deserialize_xml(std::list<T>& lst, const std::string& name, const std::stri
             throw std::runtime_error("get value error");
         }
         if constexpr (std::is_arithmetic_v<T>) {
-            std::stringstream ss(val);
-            ss >> value;
-            if (ss.fail()) {
+            if (!parse_value(val, value)) {
                 throw std::runtime_error("parsing attribute value error");
             }
         }
@@ -332,24 +626,20 @@ void deserialize_xml(std::list<T>& lst, const std::string& name, const std::stri
 
 // serialize for set
 template<typename T>
-void serialize_xml(const std::set<T>& st, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) { // if the file does not exist
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization"); // try to find the root element <serialization><\serialization>
-        if (!serialization) { // insert the root element
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+void serialize_xml(const std::set<T>& st, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // create a new element for set
     XMLElement* std_set = doc.NewElement(name.c_str());
 
+    if constexpr (packable_v<T>) {
+        if (archive.format().packed_numbers) {
+            write_packed(std_set, st.begin(), st.end());
+            archive.insert_first(std_set);
+            return;
+        }
+    }
+
     // create elements for the set's contents
     for (const auto& element : st) {
         XMLElement* xml_element = doc.NewElement("element");
@@ -359,33 +649,29 @@ void serialize_xml(const std::set<T>& st, const std::string& name, const std::st
         std_set->InsertEndChild(xml_element);
     }
 
-    serialization->InsertFirstChild(std_set);
-
-    doc.SaveFile(filename.c_str());
+    archive.insert_first(std_set);
 }
 
 
 // Deserialize std::set from XML
 template<typename T>
-void deserialize_xml(std::set<T>& st, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    // Load the XML file
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("file open error");
-    }
-
-    // Get the root element <serialization>
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-
+void deserialize_xml(std::set<T>& st, const std::string& name, XMLArchive& archive) {
     // Find the specific set element by name
-    XMLElement* std_set = serialization->FirstChildElement(name.c_str());
+    XMLElement* std_set = archive.find(name);
     if (!std_set) {
         throw std::runtime_error("fail to find the serialization element");
     }
 
     // Clear the set
     st.clear();
-    
+
+    if constexpr (packable_v<T>) {
+        if (is_packed(std_set)) {
+            read_packed<T>(std_set->GetText(), std::inserter(st, st.end()));
+            return;
+        }
+    }
+
     T value;
     // Iterate through each <element> in the set
     for (XMLElement* xml_element = std_set->FirstChildElement("element"); xml_element; xml_element = xml_element->NextSiblingElement()) {
@@ -395,9 +681,7 @@ void deserialize_xml(std::set<T>& st, const std::string& name, const std::string
         }
         // Parse the value based on its type
         if constexpr (std::is_arithmetic_v<T>) {
-            std::stringstream ss(val);
-            ss >> value;
-            if (ss.fail()) {
+            if (!parse_value(val, value)) {
                 throw std::runtime_error("parsing attribute value error");
             }
         } else if constexpr (std::is_same_v<T, std::string>) {
@@ -409,21 +693,8 @@ void deserialize_xml(std::set<T>& st, const std::string& name, const std::string
 
 // Serialize std::pair to XML
 template<typename K, typename V>
-void serialize_xml(const std::pair<K, V>& pair, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-    // Load the XML file, create a new <serialization> element if not found
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization");
-        if (!serialization) {
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+void serialize_xml(const std::pair<K, V>& pair, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
     
     // Create a new element for the pair
     XMLElement* std_pair = doc.NewElement(name.c_str());
@@ -445,23 +716,14 @@ void serialize_xml(const std::pair<K, V>& pair, const std::string& name, const s
     std_pair->InsertEndChild(second);
 
     // Insert the pair element into the serialization root
-    serialization->InsertEndChild(std_pair);
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(std_pair);
 }
 
 // Deserialize std::pair from XML
 template<typename K, typename V>
-void deserialize_xml(std::pair<K, V>& pair, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    // Load the XML file
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("file open error");
-    }
-    
-    // Get the root element <serialization>
-    XMLElement* serialization = doc.FirstChildElement("serialization");
+void deserialize_xml(std::pair<K, V>& pair, const std::string& name, XMLArchive& archive) {
     // Find the specific pair element by name
-    XMLElement* std_pair = serialization->FirstChildElement(name.c_str());
+    XMLElement* std_pair = archive.find(name);
     if (!std_pair) {
         throw std::runtime_error("fail to find the serialization element");
     }
@@ -477,9 +739,7 @@ void deserialize_xml(std::pair<K, V>& pair, const std::string& name, const std::
     // Parse the first element's value
     const char* val1 = first->Attribute("val");
     if constexpr (std::is_arithmetic_v<K>) {
-        std::stringstream ss1(val1);
-        ss1 >> pair.first;
-        if (ss1.fail()) {
+        if (!parse_value(val1, pair.first)) {
             throw std::runtime_error("parsing attribute value error");
         }
     }
@@ -493,9 +753,7 @@ void deserialize_xml(std::pair<K, V>& pair, const std::string& name, const std::
     // Parse the second element's value
     const char* val2 = second->Attribute("val");
     if constexpr (std::is_arithmetic_v<V>) {
-        std::stringstream ss2(val2);
-        ss2 >> pair.second;
-        if (ss2.fail()) {
+        if (!parse_value(val2, pair.second)) {
             throw std::runtime_error("parsing attribute value error");
         }
     }
@@ -509,22 +767,8 @@ void deserialize_xml(std::pair<K, V>& pair, const std::string& name, const std::
 
 // Serialize std::map to XML
 template<typename K, typename V>
-void serialize_xml(const std::map<K, V>& mp, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    XMLElement* serialization;
-
-    // Load the XML file, create a new <serialization> element if not found
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        serialization = doc.NewElement("serialization");
-        doc.InsertEndChild(serialization);
-    }
-    else {
-        serialization = doc.FirstChildElement("serialization");
-        if (!serialization) {
-            serialization = doc.NewElement("serialization");
-            doc.InsertEndChild(serialization);
-        }
-    }
+void serialize_xml(const std::map<K, V>& mp, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // Create a new element for the map
     XMLElement* std_map = doc.NewElement(name.c_str());
@@ -552,24 +796,17 @@ void serialize_xml(const std::map<K, V>& mp, const std::string& name, const std:
     }
 
     // Insert the map element into the serialization root
-    serialization->InsertEndChild(std_map);
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(std_map);
 }
 
 // Deserialize std::map from XML
 template<typename K, typename V>
-void deserialize_xml(std::map<K, V>& mp, const std::string& name, const std::string& filename) {
-    XMLDocument doc;
-    // Load the XML file
-    if (doc.LoadFile(filename.c_str()) != XML_SUCCESS) {
-        throw std::runtime_error("fail to open file");
-    }
-
-    // Get the root element <serialization>
-    XMLElement* serialization = doc.FirstChildElement("serialization");
-
+void deserialize_xml(std::map<K, V>& mp, const std::string& name, XMLArchive& archive) {
     // Find the specific map element by name
-    XMLElement* std_map = serialization->FirstChildElement(name.c_str());
+    XMLElement* std_map = archive.find(name);
+    if (!std_map) {
+        throw std::runtime_error("fail to find the serialization element");
+    }
     mp.clear();
     std::pair<K, V> pair;
 
@@ -581,9 +818,7 @@ void deserialize_xml(std::map<K, V>& mp, const std::string& name, const std::str
         // Parse the first element's value
         const char* val1 = first->Attribute("val");
         if constexpr (std::is_arithmetic_v<K>) {
-            std::stringstream ss1(val1);
-            ss1 >> pair.first;
-            if (ss1.fail()) {
+            if (!parse_value(val1, pair.first)) {
                 throw std::runtime_error("parsing attribute value error");
             }
         }
@@ -597,9 +832,7 @@ void deserialize_xml(std::map<K, V>& mp, const std::string& name, const std::str
         // Parse the second element's value
         const char* val2 = second->Attribute("val");
         if constexpr (std::is_arithmetic_v<V>) {
-            std::stringstream ss2(val2);
-            ss2 >> pair.second;
-            if (ss2.fail()) {
+            if (!parse_value(val2, pair.second)) {
                 throw std::runtime_error("parsing attribute value error");
             }
         }
@@ -614,6 +847,94 @@ void deserialize_xml(std::map<K, V>& mp, const std::string& name, const std::str
     }    
 }
 
+// Serialize an array of size values, as held by the unique_ptr and shared_ptr overloads
+template<typename T>
+void serialize_array_xml(const T* data, size_t size, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
+
+    // create a new element for the array
+    XMLElement* array = doc.NewElement(name.c_str());
+
+    if constexpr (packable_v<T>) {
+        if (archive.format().base64_blobs) {
+            write_blob(array, data, size);
+            archive.insert_last(array);
+            return;
+        }
+        if (archive.format().packed_numbers) {
+            write_packed(array, data, data + size);
+            archive.insert_last(array);
+            return;
+        }
+    }
+
+    // create elements for the array's contents
+    for (size_t i = 0; i < size; ++i) {
+        XMLElement* xml_element = doc.NewElement("element");
+        if constexpr (std::is_arithmetic_v<T>) xml_element->SetAttribute("val", data[i]);
+        else if constexpr (std::is_same_v<T, std::string>) xml_element->SetAttribute("val", data[i].c_str());
+        else throw std::runtime_error("this type cannot be serialized");
+        array->InsertEndChild(xml_element);
+    }
+
+    archive.insert_last(array);
+}
+
+// Deserialize an array written by serialize_array_xml, in any of its layouts
+template<typename T>
+std::unique_ptr<T[]> deserialize_array_xml(const std::string& name, XMLArchive& archive) {
+    XMLElement* array = archive.find(name);
+    if (!array) {
+        throw std::runtime_error("fail to find the serialization element");
+    }
+
+    if constexpr (packable_v<T>) {
+        if (is_blob(array)) {
+            size_t size = blob_count<T>(array->Attribute("type"), array->Attribute("count"));
+            std::unique_ptr<T[]> ptr(new T[size]);
+            read_blob(array->GetText(), ptr.get(), size);
+            return ptr;
+        }
+    }
+
+    // the textual layouts are read like a vector
+    std::vector<T> items;
+    deserialize_xml(items, name, archive);
+    std::unique_ptr<T[]> ptr(new T[items.size()]);
+    std::move(items.begin(), items.end(), ptr.get());
+    return ptr;
+}
+
+// Serialize std::unique_ptr array to XML
+template<typename T>
+void serialize_xml(const std::unique_ptr<T[]>& ptr, const std::string& name, XMLArchive& archive, size_t size) {
+    if (!ptr && size) {
+        throw std::runtime_error("invalid unique_ptr for serialization");
+    }
+    serialize_array_xml(ptr.get(), size, name, archive);
+}
+
+// Deserialize std::unique_ptr array from XML
+template<typename T>
+void deserialize_xml(std::unique_ptr<T[]>& ptr, const std::string& name, XMLArchive& archive) {
+    ptr = deserialize_array_xml<T>(name, archive);
+}
+
+// Serialize std::shared_ptr array to XML
+template<typename T>
+void serialize_xml(const std::shared_ptr<T[]>& ptr, const std::string& name, XMLArchive& archive, size_t size) {
+    if (!ptr && size) {
+        throw std::runtime_error("invalid shared_ptr for serialization");
+    }
+    serialize_array_xml(ptr.get(), size, name, archive);
+}
+
+// Deserialize std::shared_ptr array from XML
+template<typename T>
+void deserialize_xml(std::shared_ptr<T[]>& ptr, const std::string& name, XMLArchive& archive) {
+    ptr = deserialize_array_xml<T>(name, archive);
+}
+
 // A template struct to detect whether the object T has a member function `serialize_xml(tinyxml2::XMLElement&)`
 template<typename, typename = std::void_t<>>
 struct has_serialize_xml : std::false_type {};
@@ -631,52 +952,557 @@ struct has_deserialize_xml<T, std::void_t<decltype(std::declval<T>().deserialize
 // Serialize user-defined type to XML
 template<typename T>
 typename std::enable_if<has_serialize_xml<T>::value, void>::type
-serialize_xml(const T& value, const std::string& name, const std::string& filename) {
-    tinyxml2::XMLDocument doc;
-    tinyxml2::XMLElement* serialization;
-
-    // Load the XML file, create a new <serialization> element if not found
-    if (doc.LoadFile(filename.c_str()) != tinyxml2::XML_SUCCESS) {
-        serialization = doc.NewElement("serialization");
-        doc.InsertFirstChild(serialization);
-    } else {
-        serialization = doc.FirstChildElement("serialization");
-        if (!serialization) {
-            serialization = doc.NewElement("serialization");
-            doc.InsertFirstChild(serialization);
-        }
-    }
+serialize_xml(const T& value, const std::string& name, XMLArchive& archive) {
+    XMLDocument& doc = archive.document();
 
     // Create a new element for the user-defined type
     tinyxml2::XMLElement* element = doc.NewElement(name.c_str());
     value.serialize_xml(*element); // Call the user-defined serialize function
-    serialization->InsertEndChild(element); // Insert the element into the serialization root
-    doc.SaveFile(filename.c_str());
+    archive.insert_last(element); // Insert the element into the serialization root
 }
 
 // Deserialize user-defined type from XML
 template<typename T>
 typename std::enable_if<has_deserialize_xml<T>::value, void>::type
-deserialize_xml(T& value, const std::string& name, const std::string& filename) {
-    tinyxml2::XMLDocument doc;
-    // Load the XML file
-    if (doc.LoadFile(filename.c_str()) != tinyxml2::XML_SUCCESS) {
-        throw std::runtime_error("file open error");
+deserialize_xml(T& value, const std::string& name, XMLArchive& archive) {
+    // Find the specific element by name
+    tinyxml2::XMLElement* element = archive.find(name);
+    if (!element) {
+        throw std::runtime_error("fail to find the element with the specified name.");
+    }
+
+    value.deserialize_xml(*element); // Call the user-defined deserialize function
+}
+
+// A write-only XML file produced in one pass, without building a document.
+// Each serialize_xml call prints its entry straight through an XMLPrinter, so memory stays flat however
+// large the output grows. Entries appear in call order under the same <serialization> root an XMLArchive
+// writes, and the file reads back through an XMLArchive. The root is closed on close() or destruction
+class XMLStreamArchive {
+public:
+    explicit XMLStreamArchive(const std::string& filename, XMLFormat format = {})
+        : format_(format), file_(open(filename)), printer_(file_) {
+        printer_.SetBuffered(true);
+        printer_.SetDirectWrite(true); // the printer buffers on its own, so stdio would only add a copy
+        printer_.OpenElement("serialization");
+    }
+
+    XMLStreamArchive(const XMLStreamArchive&) = delete;
+    XMLStreamArchive& operator=(const XMLStreamArchive&) = delete;
+
+    // The file is completed on destruction; errors can only be observed through an explicit close()
+    ~XMLStreamArchive() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    // Close the root element and the file. No more entries can be written afterwards
+    void close() {
+        if (!file_) {
+            return;
+        }
+        printer_.CloseElement();
+        printer_.Flush();
+        bool failed = printer_.WriteError() || ferror(file_) != 0;
+        failed = fclose(file_) != 0 || failed;
+        file_ = nullptr;
+        if (failed) {
+            throw std::runtime_error("file save error");
+        }
+    }
+
+    XMLPrinter& printer() {
+        if (!file_) {
+            throw std::runtime_error("stream archive is closed");
+        }
+        return printer_;
+    }
+
+    const XMLFormat& format() const { return format_; }
+
+    // Print an entry built by fill on a scratch element, for types that only know how to fill an XMLElement.
+    // The scratch document is reset right after printing, so its nodes and interned names are recycled
+    // by the next entry instead of piling up over the life of the archive
+    template<typename Fill>
+    void print_element(const std::string& name, Fill fill) {
+        XMLElement* element = scratch_.NewElement(name.c_str());
+        fill(*element);
+        element->Accept(&printer());
+        scratch_.Reset();
+    }
+
+private:
+    static FILE* open(const std::string& filename) {
+        FILE* file = fopen(filename.c_str(), "w");
+        if (!file) {
+            throw std::runtime_error("file open error");
+        }
+        return file;
+    }
+
+    XMLFormat format_;
+    FILE* file_;
+    XMLPrinter printer_;
+    XMLDocument scratch_;
+};
+
+// Push the "val" attribute of a container item, pair member or map entry
+template<typename T>
+void push_value(XMLPrinter& printer, const T& value) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        char buffer[64];
+        value_text(value, buffer, sizeof(buffer));
+        printer.PushAttribute("val", buffer);
+    }
+    else if constexpr (std::is_same_v<T, std::string>) printer.PushAttribute("val", value.c_str());
+    else throw std::runtime_error("this type cannot be serialized");
+}
+
+// Print the text of write_packed one number at a time
+template<typename It>
+void stream_packed(XMLPrinter& printer, It first, It last) {
+    char buffer[64];
+    for (bool separate = false; first != last; ++first, separate = true) {
+        char* cur = buffer;
+        if (separate) {
+            *cur++ = ' ';
+        }
+        value_text(*first, cur, static_cast<int>(buffer + sizeof(buffer) - cur));
+        printer.PushText(buffer);
+    }
+}
+
+// Print the attributes and text of write_blob, encoding a bounded chunk at a time.
+// Chunks hold whole 3-byte groups, so their base64 texts concatenate into the text of the whole blob
+template<typename T>
+void stream_blob(XMLPrinter& printer, const T* data, size_t count) {
+    constexpr size_t chunk = 3 * 1024;
+    printer.PushAttribute("encoding", "base64");
+    printer.PushAttribute("type", blob_type<T>().c_str());
+    printer.PushAttribute("count", static_cast<uint64_t>(count));
+    const char* bytes = reinterpret_cast<const char*>(data);
+    size_t size = count * sizeof(T);
+    char text[base64::encoded_size(chunk) + 1];
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        size_t length = size - offset < chunk ? size - offset : chunk;
+        base64::encode(bytes + offset, length, text);
+        text[base64::encoded_size(length)] = '\0';
+        printer.PushText(text);
+    }
+}
+
+// Print a sequence container or array in the layout XMLArchive would store it in
+template<typename It>
+void serialize_range_xml(It first, It last, const std::string& name, XMLStreamArchive& archive) {
+    using T = typename std::iterator_traits<It>::value_type;
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    if constexpr (packable_v<T>) {
+        if constexpr (std::contiguous_iterator<It>) {
+            if (archive.format().base64_blobs) {
+                stream_blob(printer, std::to_address(first), static_cast<size_t>(last - first));
+                printer.CloseElement();
+                return;
+            }
+        }
+        if (archive.format().packed_numbers) {
+            stream_packed(printer, first, last);
+            printer.CloseElement();
+            return;
+        }
     }
+    for (; first != last; ++first) {
+        printer.OpenElement("element");
+        push_value(printer, *first);
+        printer.CloseElement();
+    }
+    printer.CloseElement();
+}
 
-    // Get the root element <serialization>
-    tinyxml2::XMLElement* serialization = doc.FirstChildElement("serialization");
-    if (!serialization) {
+// Stream arithmetic types (excluding char)
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, void>::type
+serialize_xml(const T& value, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    push_value(printer, value);
+    printer.CloseElement();
+}
+
+// Stream char type as a string of length 1
+template<typename T>
+typename std::enable_if<std::is_same<T, char>::value, void>::type
+serialize_xml(const T& value, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    printer.PushAttribute("val", std::string(1, value).c_str());
+    printer.CloseElement();
+}
+
+// Stream string
+inline void serialize_xml(const std::string& value, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    printer.PushAttribute("val", value.c_str());
+    printer.CloseElement();
+}
+
+// Stream vector
+template<typename T>
+void serialize_xml(const std::vector<T>& vec, const std::string& name, XMLStreamArchive& archive) {
+    serialize_range_xml(vec.begin(), vec.end(), name, archive);
+}
+
+// Stream list
+template<typename T>
+void serialize_xml(const std::list<T>& lst, const std::string& name, XMLStreamArchive& archive) {
+    serialize_range_xml(lst.begin(), lst.end(), name, archive);
+}
+
+// Stream set
+template<typename T>
+void serialize_xml(const std::set<T>& st, const std::string& name, XMLStreamArchive& archive) {
+    serialize_range_xml(st.begin(), st.end(), name, archive);
+}
+
+// Stream the <first> and <second> children of a pair or map entry
+template<typename K, typename V>
+void stream_pair(XMLPrinter& printer, const K& first, const V& second) {
+    printer.OpenElement("first");
+    push_value(printer, first);
+    printer.CloseElement();
+    printer.OpenElement("second");
+    push_value(printer, second);
+    printer.CloseElement();
+}
+
+// Stream std::pair
+template<typename K, typename V>
+void serialize_xml(const std::pair<K, V>& pair, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    stream_pair(printer, pair.first, pair.second);
+    printer.CloseElement();
+}
+
+// Stream std::map
+template<typename K, typename V>
+void serialize_xml(const std::map<K, V>& mp, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    for (const auto& pair : mp) {
+        printer.OpenElement("pair");
+        stream_pair(printer, pair.first, pair.second);
+        printer.CloseElement();
+    }
+    printer.CloseElement();
+}
+
+// Stream std::unique_ptr array
+template<typename T>
+void serialize_xml(const std::unique_ptr<T[]>& ptr, const std::string& name, XMLStreamArchive& archive, size_t size) {
+    if (!ptr && size) {
+        throw std::runtime_error("invalid unique_ptr for serialization");
+    }
+    serialize_range_xml(ptr.get(), ptr.get() + size, name, archive);
+}
+
+// Stream std::shared_ptr array
+template<typename T>
+void serialize_xml(const std::shared_ptr<T[]>& ptr, const std::string& name, XMLStreamArchive& archive, size_t size) {
+    if (!ptr && size) {
+        throw std::runtime_error("invalid shared_ptr for serialization");
+    }
+    serialize_range_xml(ptr.get(), ptr.get() + size, name, archive);
+}
+
+// A template struct to detect whether the object T has a member function `serialize_xml(tinyxml2::XMLPrinter&)`,
+// which pushes the attributes and children of an element that is already open
+template<typename, typename = std::void_t<>>
+struct has_stream_serialize_xml : std::false_type {};
+
+template<typename T>
+struct has_stream_serialize_xml<T, std::void_t<decltype(std::declval<T>().serialize_xml(std::declval<tinyxml2::XMLPrinter&>()))>> : std::true_type {};
+
+// Stream user-defined type that prints itself
+template<typename T>
+typename std::enable_if<has_stream_serialize_xml<T>::value, void>::type
+serialize_xml(const T& value, const std::string& name, XMLStreamArchive& archive) {
+    XMLPrinter& printer = archive.printer();
+    printer.OpenElement(name.c_str());
+    value.serialize_xml(printer); // Call the user-defined streaming function
+    printer.CloseElement();
+}
+
+// Stream user-defined type that fills an XMLElement, through a scratch element
+template<typename T>
+typename std::enable_if<has_serialize_xml<T>::value && !has_stream_serialize_xml<T>::value, void>::type
+serialize_xml(const T& value, const std::string& name, XMLStreamArchive& archive) {
+    archive.print_element(name, [&](XMLElement& element) { value.serialize_xml(element); });
+}
+
+// The next event of a pull parser, with parse errors and a premature end of the document thrown
+inline XMLPullParser::Event pull_next(XMLPullParser& parser) {
+    XMLPullParser::Event event = parser.Next();
+    if (event == XMLPullParser::PARSE_ERROR || event == XMLPullParser::END_DOCUMENT) {
+        throw std::runtime_error("xml parsing error");
+    }
+    return event;
+}
+
+// Skip the rest of the element whose start was just read, children included
+inline void pull_skip(XMLPullParser& parser) {
+    for (int depth = 0;;) {
+        XMLPullParser::Event event = pull_next(parser);
+        if (event == XMLPullParser::START_ELEMENT) {
+            ++depth;
+        } else if (event == XMLPullParser::END_ELEMENT && depth-- == 0) {
+            return;
+        }
+    }
+}
+
+// Advance to the start of the first entry with the given name under the root <serialization>
+inline void pull_find(XMLPullParser& parser, const std::string& name) {
+    XMLPullParser::Event event = parser.Next();
+    if (event != XMLPullParser::START_ELEMENT || strcmp(parser.Name(), "serialization") != 0) {
         throw std::runtime_error("fail to find serialization element.");
     }
+    while ((event = pull_next(parser)) != XMLPullParser::END_ELEMENT) {
+        if (event == XMLPullParser::START_ELEMENT) {
+            if (name == parser.Name()) {
+                return;
+            }
+            pull_skip(parser);
+        }
+    }
+    throw std::runtime_error("fail to find the serialization element");
+}
 
-    // Find the specific element by name
-    tinyxml2::XMLElement* element = serialization->FirstChildElement(name.c_str());
-    if (!element) {
-        throw std::runtime_error("fail to find the element with the specified name.");
+// Read the "val" attribute of the element whose start was just read, and skip the rest of it
+template<typename T>
+void pull_value(XMLPullParser& parser, T& value) {
+    bool found = false;
+    XMLPullParser::Event event;
+    while ((event = pull_next(parser)) == XMLPullParser::ATTRIBUTE) {
+        if (strcmp(parser.Name(), "val") != 0) {
+            continue;
+        }
+        found = true;
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (!parse_value(parser.Value(), value)) {
+                throw std::runtime_error("parsing attribute value error");
+            }
+        }
+        else if constexpr (std::is_same_v<T, std::string>) {
+            value = parser.Value();
+        }
+        else {
+            throw std::runtime_error("parsing attribute value error");
+        }
+    }
+    if (!found) {
+        throw std::runtime_error("get value error");
+    }
+    // the element has content after all: skip the first node of it, then the rest
+    if (event == XMLPullParser::START_ELEMENT) {
+        pull_skip(parser);
     }
+    if (event != XMLPullParser::END_ELEMENT) {
+        pull_skip(parser);
+    }
+}
 
-    value.deserialize_xml(*element); // Call the user-defined deserialize function
+// Read the items of a vector, list, set or array entry in any of its layouts, storing them through out.
+// A blob is decoded straight into *direct when it is given, and through a temporary vector otherwise
+template<typename T, typename OutputIt>
+void pull_sequence(XMLPullParser& parser, OutputIt out, std::vector<T>* direct = nullptr) {
+    bool blob = false;
+    std::string type, count;
+    XMLPullParser::Event event;
+    while ((event = pull_next(parser)) == XMLPullParser::ATTRIBUTE) {
+        const char* attribute = parser.Name();
+        if (strcmp(attribute, "encoding") == 0) {
+            blob = strcmp(parser.Value(), "base64") == 0;
+        } else if (strcmp(attribute, "type") == 0) {
+            type = parser.Value();
+        } else if (strcmp(attribute, "count") == 0) {
+            count = parser.Value();
+        }
+    }
+
+    [[maybe_unused]] std::vector<T> scratch;
+    [[maybe_unused]] std::string text;
+    if constexpr (packable_v<T>) {
+        if (blob) {
+            if (!direct) {
+                direct = &scratch;
+            }
+            direct->resize(blob_count<T>(type.c_str(), count.c_str()));
+        }
+    }
+
+    for (; event != XMLPullParser::END_ELEMENT; event = pull_next(parser)) {
+        if (event == XMLPullParser::START_ELEMENT) {
+            T value;
+            pull_value(parser, value);
+            *out++ = value;
+        }
+        else if constexpr (packable_v<T>) {
+            // text split by comments or CDATA sections is one run: gather it before decoding
+            if (event == XMLPullParser::TEXT) {
+                text += parser.Value();
+            }
+        }
+    }
+
+    if constexpr (packable_v<T>) {
+        if (blob) {
+            read_blob(text.c_str(), direct->data(), direct->size());
+            if (direct == &scratch) {
+                std::move(scratch.begin(), scratch.end(), out);
+            }
+        } else if (!text.empty()) {
+            read_packed<T>(text.c_str(), out);
+        }
+    }
+}
+
+// Read the <first> and <second> children of a pair or map entry, skipping anything else
+template<typename K, typename V>
+void pull_pair(XMLPullParser& parser, K& first, V& second) {
+    bool hasFirst = false, hasSecond = false;
+    for (XMLPullParser::Event event = pull_next(parser); event != XMLPullParser::END_ELEMENT; event = pull_next(parser)) {
+        if (event != XMLPullParser::START_ELEMENT) {
+            continue;
+        }
+        if (!hasFirst && strcmp(parser.Name(), "first") == 0) {
+            pull_value(parser, first);
+            hasFirst = true;
+        } else if (!hasSecond && strcmp(parser.Name(), "second") == 0) {
+            pull_value(parser, second);
+            hasSecond = true;
+        } else {
+            pull_skip(parser);
+        }
+    }
+    if (!hasFirst || !hasSecond) {
+        throw std::runtime_error("fail to find the serialization element");
+    }
+}
+
+// The deserialize_xml overloads below read an entry from a pull parser positioned right after its start tag,
+// as pull_find leaves it. They accept the same layouts as the XMLArchive overloads
+
+// Pull arithmetic types (excluding char)
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value, void>::type
+deserialize_xml(T& value, XMLPullParser& parser) {
+    pull_value(parser, value);
+}
+
+// Pull char type, stored as a string of length 1
+template<typename T>
+typename std::enable_if<std::is_same<T, char>::value, void>::type
+deserialize_xml(T& value, XMLPullParser& parser) {
+    std::string val;
+    pull_value(parser, val);
+    if (val.size() != 1) {
+        throw std::runtime_error("Invalid char length");
+    }
+    value = val[0];
+}
+
+// Pull string
+inline void deserialize_xml(std::string& value, XMLPullParser& parser) {
+    pull_value(parser, value);
+}
+
+// Pull vector
+template<typename T>
+void deserialize_xml(std::vector<T>& vec, XMLPullParser& parser) {
+    vec.clear();
+    pull_sequence<T>(parser, std::back_inserter(vec), &vec);
+}
+
+// Pull list
+template<typename T>
+void deserialize_xml(std::list<T>& lst, XMLPullParser& parser) {
+    lst.clear();
+    pull_sequence<T>(parser, std::back_inserter(lst));
+}
+
+// Pull set; items written in order are inserted at the end in constant time
+template<typename T>
+void deserialize_xml(std::set<T>& st, XMLPullParser& parser) {
+    st.clear();
+    pull_sequence<T>(parser, std::inserter(st, st.end()));
+}
+
+// Pull std::pair
+template<typename K, typename V>
+void deserialize_xml(std::pair<K, V>& pair, XMLPullParser& parser) {
+    pull_pair(parser, pair.first, pair.second);
+}
+
+// Pull std::map
+template<typename K, typename V>
+void deserialize_xml(std::map<K, V>& mp, XMLPullParser& parser) {
+    mp.clear();
+    for (XMLPullParser::Event event = pull_next(parser); event != XMLPullParser::END_ELEMENT; event = pull_next(parser)) {
+        if (event == XMLPullParser::START_ELEMENT) {
+            std::pair<K, V> pair;
+            pull_pair(parser, pair.first, pair.second);
+            mp.insert(mp.end(), std::move(pair));
+        }
+    }
+}
+
+// Pull std::unique_ptr array
+template<typename T>
+void deserialize_xml(std::unique_ptr<T[]>& ptr, XMLPullParser& parser) {
+    std::vector<T> items;
+    pull_sequence<T>(parser, std::back_inserter(items), &items);
+    ptr.reset(new T[items.size()]);
+    std::move(items.begin(), items.end(), ptr.get());
+}
+
+// Pull std::shared_ptr array
+template<typename T>
+void deserialize_xml(std::shared_ptr<T[]>& ptr, XMLPullParser& parser) {
+    std::unique_ptr<T[]> items;
+    deserialize_xml(items, parser);
+    ptr = std::move(items);
+}
+
+// Serialize any supported type into a file: the file is loaded, the value appended and the file saved.
+// To write many values into one file, use an XMLArchive directly instead
+template<typename T>
+void serialize_xml(const T& value, const std::string& name, const std::string& filename) {
+    XMLArchive archive(filename);
+    serialize_xml(value, name, archive);
+    archive.commit();
+}
+
+// Deserialize any supported type from a file.
+// The file is scanned with a pull parser up to the entry and the value read straight from the events,
+// without building a document. User-defined types read themselves from an XMLElement, so for those the
+// document is loaded into an XMLArchive instead. To read many values from one file, use an XMLArchive directly
+template<typename T>
+void deserialize_xml(T& value, const std::string& name, const std::string& filename) {
+    if constexpr (has_deserialize_xml<T>::value) {
+        XMLArchive archive(filename, XMLArchive::READ);
+        deserialize_xml(value, name, archive);
+    } else {
+        XMLPullParser parser;
+        if (parser.LoadFile(filename.c_str()) != XML_SUCCESS) {
+            throw std::runtime_error("file open error");
+        }
+        pull_find(parser, name);
+        deserialize_xml(value, parser);
+    }
 }
 
 
@@ -6,12 +6,32 @@
 #include <list>
 #include <set>
 #include <memory>
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <string_view>
+#include <span>
+#include <optional>
+#include <sstream>
+#include <cstdio>
+#include <thread>
 #include "../include/binary_serialization.hpp"
 #include "../include/xml_serialization.hpp"
 
 using namespace BinarySerialization;
 using namespace XMLSerialization;
 
+// A plain struct stored as raw bytes
+struct Point {
+    float x, y, z;
+    bool operator==(const Point& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+template<>
+struct BinarySerialization::is_block_serializable<Point> : std::true_type {};
+
 class Person {
 public:
     std::string name;
@@ -80,6 +100,42 @@ public:
     }
 };
 
+// A user type with member templates, written to and read from archives directly and in their format
+struct Reading {
+    int64_t time = 0;
+    std::vector<int32_t> values;
+
+    bool operator==(const Reading& other) const { return time == other.time && values == other.values; }
+
+    template<typename Out>
+    void serialize(Out& os) const {
+        BinarySerialization::serialize(this->time, os);
+        BinarySerialization::serialize(this->values, os);
+    }
+
+    size_t serialized_size(const BinaryFormat& format) const {
+        return BinarySerialization::serialized_size(this->time, format)
+             + BinarySerialization::serialized_size(this->values, format);
+    }
+
+    template<typename In>
+    void deserialize(In& is) {
+        BinarySerialization::deserialize(this->time, is);
+        BinarySerialization::deserialize(this->values, is);
+    }
+};
+
+// A user type that writes nothing at all
+struct Marker {
+    bool operator==(const Marker&) const { return true; }
+
+    template<typename Out>
+    void serialize(Out&) const {}
+
+    template<typename In>
+    void deserialize(In&) {}
+};
+
 void test_unique_ptr_serialization() {
     const size_t size = 5;
     auto uptr = std::make_unique<int[]>(size);
@@ -130,6 +186,524 @@ void test_shared_ptr_serialization() {
     std::cout << "Shared pointer serialization test passed." << std::endl;
 }
 
+void test_binary_writer() {
+    std::vector<int> vectorVar = {1, 2, 3, 4, 5};
+    std::map<std::string, double> mapVar = {{"a", 1.5}, {"bc", 2.5}};
+    Person personVar("Leo Ding", 30, 1.75);
+
+    // Reference bytes written straight to the stream
+    std::ostringstream expected;
+    serialize(vectorVar, expected);
+    serialize(mapVar, expected);
+    serialize(personVar, expected);
+
+    // A tiny capacity forces both the drain and the pass-through paths
+    std::ostringstream buffered;
+    {
+        BinaryWriter writer(buffered, 8);
+        serialize(vectorVar, writer);
+        serialize(mapVar, writer);
+        serialize(personVar, writer);
+        ASSERT(writer.bytes_written() == expected.str().size(), "BinaryWriter byte count does not match.");
+    }
+    ASSERT(buffered.str() == expected.str(), "BinaryWriter(std::ostream) output does not match.");
+
+    // The same bytes through a FILE*
+    FILE* file = std::fopen("writer.bin", "wb");
+    ASSERT(file != nullptr, "Failed to open writer.bin.");
+    {
+        BinaryWriter writer(file);
+        serialize(vectorVar, writer);
+        serialize(mapVar, writer);
+        serialize(personVar, writer);
+    }
+    std::fclose(file);
+    std::ifstream ifs("writer.bin", std::ios::binary);
+    std::string fileContents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    ASSERT(fileContents == expected.str(), "BinaryWriter(FILE*) output does not match.");
+
+    std::cout << "Binary writer test passed." << std::endl;
+}
+
+void test_binary_reader() {
+    std::vector<std::string> vectorVar = {"bob and john,", "leo,", "hi,"};
+    std::map<int, double> mapVar = {{1, 2.2}, {3, 4.4}};
+    Person personVar("Leo Ding", 30, 1.75);
+
+    std::ostringstream oss;
+    {
+        BinaryWriter writer(oss);
+        serialize(vectorVar, writer);
+        serialize(mapVar, writer);
+        serialize(personVar, writer);
+    }
+    const std::string bytes = oss.str();
+
+    // Round trip through a borrowed buffer
+    std::vector<std::string> vectorVar2;
+    std::map<int, double> mapVar2;
+    Person personVar2;
+    BinaryReader reader(bytes.data(), bytes.size());
+    deserialize(vectorVar2, reader);
+    deserialize(mapVar2, reader);
+    deserialize(personVar2, reader);
+    ASSERT(reader.eof(), "BinaryReader did not consume the whole buffer.");
+    ASSERT(vectorVar2 == vectorVar, "BinaryReader vector(string) does not match.");
+    ASSERT(mapVar2 == mapVar, "BinaryReader map does not match.");
+    ASSERT(personVar2 == personVar, "BinaryReader person does not match.");
+
+    // A truncated buffer must be reported, not silently accepted
+    bool threw = false;
+    try {
+        BinaryReader truncated(std::vector<char>(bytes.begin(), bytes.end() - 1));
+        deserialize(vectorVar2, truncated);
+        deserialize(mapVar2, truncated);
+        deserialize(personVar2, truncated);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "BinaryReader accepted truncated input.");
+
+    std::cout << "Binary reader test passed." << std::endl;
+}
+
+// Deserialize value from a buffer holding only a huge element count; it must fail before allocating
+template<typename T>
+bool rejects_huge_count(T& value) {
+    const size_t count = size_t(1) << 40;
+    std::vector<char> bytes(sizeof(count));
+    std::memcpy(bytes.data(), &count, sizeof(count));
+    BinaryReader reader(std::move(bytes));
+    try {
+        deserialize(value, reader);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_corrupt_counts() {
+    std::list<int> listVar;
+    std::vector<std::string> vectorVar;
+    std::map<int, int> mapVar;
+    std::set<int> setVar;
+    ASSERT(rejects_huge_count(listVar), "Huge list count was accepted.");
+    ASSERT(rejects_huge_count(vectorVar), "Huge vector(string) count was accepted.");
+    ASSERT(rejects_huge_count(mapVar), "Huge map count was accepted.");
+    ASSERT(rejects_huge_count(setVar), "Huge set count was accepted.");
+
+    // Elements that serialize to no bytes cannot be bounded by the input, but still round-trip
+    std::vector<Marker> markersVar(3);
+    std::list<Marker> markerListVar(2);
+    std::vector<std::array<int, 0>> emptyArraysVar(4);
+    std::ostringstream oss;
+    {
+        BinaryWriter writer(oss);
+        serialize(markersVar, writer);
+        serialize(markerListVar, writer);
+        serialize(emptyArraysVar, writer);
+    }
+    const std::string bytes = oss.str();
+    std::vector<Marker> markersVar2;
+    std::list<Marker> markerListVar2;
+    std::vector<std::array<int, 0>> emptyArraysVar2;
+    BinaryReader reader(bytes.data(), bytes.size());
+    deserialize(markersVar2, reader);
+    deserialize(markerListVar2, reader);
+    deserialize(emptyArraysVar2, reader);
+    ASSERT(reader.eof(), "BinaryReader did not consume the empty elements.");
+    ASSERT(markersVar2 == markersVar && markerListVar2 == markerListVar && emptyArraysVar2 == emptyArraysVar,
+           "Empty elements do not match.");
+
+    std::cout << "Corrupt count test passed." << std::endl;
+}
+
+void test_block_serialization() {
+    std::vector<double> vectorVar(100000);
+    for (size_t i = 0; i < vectorVar.size(); ++i) {
+        vectorVar[i] = static_cast<double>(i) * 0.5;
+    }
+    std::array<int, 4> arrayVar = {1, 2, 3, 4};
+    int cArrayVar[3][2] = {{1, 2}, {3, 4}, {5, 6}};
+    std::vector<Point> pointsVar = {{1.0f, 2.0f, 3.0f}, {4.0f, 5.0f, 6.0f}};
+
+    std::ostringstream oss;
+    serialize(vectorVar, oss);
+    serialize(arrayVar, oss);
+    serialize(cArrayVar, oss);
+    serialize(pointsVar, oss);
+
+    // vector size header + payload, array and C array without headers, then the points
+    size_t expectedSize = sizeof(size_t) + vectorVar.size() * sizeof(double) + sizeof(arrayVar) + sizeof(cArrayVar)
+                        + sizeof(size_t) + pointsVar.size() * sizeof(Point);
+    ASSERT(oss.str().size() == expectedSize, "Block serialization size does not match.");
+
+    std::vector<double> vectorVar2;
+    std::array<int, 4> arrayVar2 = {};
+    int cArrayVar2[3][2] = {};
+    std::vector<Point> pointsVar2;
+    const std::string bytes = oss.str();
+    BinaryReader reader(bytes.data(), bytes.size());
+    deserialize(vectorVar2, reader);
+    deserialize(arrayVar2, reader);
+    deserialize(cArrayVar2, reader);
+    deserialize(pointsVar2, reader);
+
+    ASSERT(vectorVar2 == vectorVar, "Deserialized vector(double) does not match.");
+    ASSERT(arrayVar2 == arrayVar, "Deserialized std::array does not match.");
+    ASSERT(std::memcmp(cArrayVar2, cArrayVar, sizeof(cArrayVar)) == 0, "Deserialized C array does not match.");
+    ASSERT(pointsVar2 == pointsVar, "Deserialized vector(Point) does not match.");
+
+    std::cout << "Block serialization test passed." << std::endl;
+}
+
+void test_compact_lengths() {
+    std::vector<std::string> vectorVarStr = {"bob and john,", "leo,", "hi,", std::string(300, 'x')};
+    std::map<int, std::string> mapVar = {{1, "a"}, {2, "bc"}};
+    std::set<int> setVar = {1, 2, 3};
+
+    BinaryFormat compact;
+    compact.compact_lengths = true;
+
+    std::ostringstream fixed, packed;
+    {
+        BinaryWriter writer(fixed);
+        serialize(vectorVarStr, writer);
+        serialize(mapVar, writer);
+        serialize(setVar, writer);
+    }
+    {
+        BinaryWriter writer(packed);
+        writer.set_format(compact);
+        serialize(vectorVarStr, writer);
+        serialize(mapVar, writer);
+        serialize(setVar, writer);
+    }
+    // 9 headers of 8 bytes each shrink to varints: eight single-byte lengths and one two-byte length (300)
+    ASSERT(fixed.str().size() - packed.str().size() == 9 * sizeof(size_t) - 10, "Compact lengths size does not match.");
+
+    const std::string bytes = packed.str();
+    BinaryReader reader(bytes.data(), bytes.size());
+    reader.set_format(compact);
+    std::vector<std::string> vectorVarStr2;
+    std::map<int, std::string> mapVar2;
+    std::set<int> setVar2;
+    deserialize(vectorVarStr2, reader);
+    deserialize(mapVar2, reader);
+    deserialize(setVar2, reader);
+    ASSERT(reader.eof(), "Compact reader did not consume the whole buffer.");
+    ASSERT(vectorVarStr2 == vectorVarStr, "Compact vector(string) does not match.");
+    ASSERT(mapVar2 == mapVar, "Compact map does not match.");
+    ASSERT(setVar2 == setVar, "Compact set does not match.");
+
+    std::cout << "Compact length encoding test passed." << std::endl;
+}
+
+void test_varint_integers() {
+    int64_t counterVar = 42;
+    std::vector<int64_t> deltasVar;
+    for (int64_t i = -1000; i < 1000; ++i) {
+        deltasVar.push_back(i);
+    }
+    deltasVar.push_back(std::numeric_limits<int64_t>::min());
+    deltasVar.push_back(std::numeric_limits<int64_t>::max());
+    std::map<uint32_t, int> mapVar = {{1, -1}, {300, 70000}};
+
+    // Per archive: every integer becomes a varint
+    BinaryFormat format;
+    format.compact_lengths = true;
+    format.varint_integers = true;
+    std::ostringstream oss;
+    {
+        BinaryWriter writer(oss);
+        writer.set_format(format);
+        serialize(counterVar, writer);
+        serialize(deltasVar, writer);
+        serialize(mapVar, writer);
+    }
+    const std::string bytes = oss.str();
+    size_t rawSize = sizeof(int64_t) * (1 + deltasVar.size()) + 2 * (sizeof(uint32_t) + sizeof(int));
+    ASSERT(bytes.size() * 3 < rawSize, "Varint integers did not shrink the payload.");
+
+    int64_t counterVar2 = 0;
+    std::vector<int64_t> deltasVar2;
+    std::map<uint32_t, int> mapVar2;
+    BinaryReader reader(bytes.data(), bytes.size());
+    reader.set_format(format);
+    deserialize(counterVar2, reader);
+    deserialize(deltasVar2, reader);
+    deserialize(mapVar2, reader);
+    ASSERT(reader.eof(), "Varint reader did not consume the whole buffer.");
+    ASSERT(counterVar2 == counterVar, "Varint int64 does not match.");
+    ASSERT(deltasVar2 == deltasVar, "Varint vector(int64) does not match.");
+    ASSERT(mapVar2 == mapVar, "Varint map does not match.");
+
+    // Per call, on a plain stream
+    std::stringstream ss;
+    serialize(varint(counterVar), ss);
+    serialize(varint(deltasVar), ss);
+    counterVar2 = 0;
+    deltasVar2.clear();
+    deserialize(varint(counterVar2), ss);
+    deserialize(varint(deltasVar2), ss);
+    ASSERT(counterVar2 == counterVar, "Per-call varint int64 does not match.");
+    ASSERT(deltasVar2 == deltasVar, "Per-call varint vector(int64) does not match.");
+
+    // A value that does not fit the target type is an error
+    std::stringstream big;
+    serialize(varint(counterVar = 70000), big);
+    int16_t narrow = 0;
+    bool threw = false;
+    try {
+        deserialize(varint(narrow), big);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Out of range varint was accepted.");
+
+    // A 10th byte above 1 would shift bits out past bit 63; every decoder must reject it
+    const std::string overflow = std::string(9, '\xff') + '\x02';
+    const size_t one = 1;
+    const std::string overflowVector = std::string(reinterpret_cast<const char*>(&one), sizeof(one)) + overflow;
+    auto rejects = [](auto&& decode) {
+        try {
+            decode();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    uint64_t wide = 0;
+    std::vector<uint64_t> wides;
+    ASSERT(rejects([&] { BinaryReader r(overflow.data(), overflow.size()); deserialize(varint(wide), r); }), "Overflowing varint was accepted by the reader.");
+    ASSERT(rejects([&] { BinaryReader r(overflowVector.data(), overflowVector.size()); deserialize(varint(wides), r); }), "Overflowing varint was accepted by the bulk reader.");
+    ASSERT(rejects([&] { std::stringstream s(overflow); deserialize(varint(wide), s); }), "Overflowing varint was accepted from a stream.");
+    const std::string top = std::string(9, '\xff') + '\x01';
+    BinaryReader topReader(top.data(), top.size());
+    deserialize(varint(wide), topReader);
+    ASSERT(wide == std::numeric_limits<uint64_t>::max(), "Largest varint does not decode.");
+
+    std::cout << "Varint integer test passed." << std::endl;
+}
+
+void test_zero_copy_views() {
+    std::string stringVar = "Hello, World!";
+    std::vector<double> vectorVar = {1.5, 2.5, 3.5};
+
+    // Numeric payloads first, so they stay aligned behind their 8-byte size headers
+    std::ostringstream oss;
+    serialize(vectorVar, oss);
+    serialize(std::span<const double>(vectorVar), oss);
+    serialize(stringVar, oss);
+    serialize(std::string_view("view"), oss);
+
+    // Copy into a buffer aligned for double, as a memory-mapped file would be
+    const std::string bytes = oss.str();
+    std::vector<double> storage(bytes.size() / sizeof(double) + 1);
+    std::memcpy(storage.data(), bytes.data(), bytes.size());
+
+    BinaryReader reader(storage.data(), bytes.size());
+    std::string_view stringView;
+    std::span<const double> vectorView;
+    std::string_view stringView2;
+    std::span<const double> vectorView2;
+    deserialize(vectorView, reader);
+    deserialize(vectorView2, reader);
+    deserialize(stringView, reader);
+    deserialize(stringView2, reader);
+
+    const char* begin = reinterpret_cast<const char*>(storage.data());
+    const char* end = begin + bytes.size();
+    ASSERT(stringView == stringVar, "string_view does not match.");
+    ASSERT(stringView.data() >= begin && stringView.data() < end, "string_view does not point into the buffer.");
+    ASSERT(std::equal(vectorView.begin(), vectorView.end(), vectorVar.begin(), vectorVar.end()), "span does not match.");
+    ASSERT(reinterpret_cast<const char*>(vectorView.data()) >= begin && reinterpret_cast<const char*>(vectorView.data()) < end,
+           "span does not point into the buffer.");
+    ASSERT(stringView2 == "view", "Serialized string_view does not match.");
+    ASSERT(std::equal(vectorView2.begin(), vectorView2.end(), vectorVar.begin(), vectorVar.end()), "Serialized span does not match.");
+
+    std::cout << "Zero-copy view test passed." << std::endl;
+}
+
+void test_mapped_file() {
+    std::vector<int> vectorVar(1 << 16);
+    for (size_t i = 0; i < vectorVar.size(); ++i) {
+        vectorVar[i] = static_cast<int>(i * 7);
+    }
+    std::map<std::string, double> mapVar = {{"a", 1.5}, {"bc", 2.5}};
+    Person personVar("Leo Ding", 30, 1.75);
+
+    FILE* file = std::fopen("mapped.bin", "wb");
+    ASSERT(file != nullptr, "Failed to open mapped.bin.");
+    {
+        BinaryWriter writer(file);
+        serialize(vectorVar, writer);
+        serialize(mapVar, writer);
+        serialize(personVar, writer);
+    }
+    std::fclose(file);
+
+    std::vector<int> vectorVar2;
+    std::map<std::string, double> mapVar2;
+    Person personVar2;
+    BinaryReader reader(MappedFile("mapped.bin"));
+    deserialize(vectorVar2, reader);
+    deserialize(mapVar2, reader);
+    deserialize(personVar2, reader);
+    ASSERT(reader.eof(), "Mapped reader did not consume the whole file.");
+    ASSERT(vectorVar2 == vectorVar, "Mapped vector does not match.");
+    ASSERT(mapVar2 == mapVar, "Mapped map does not match.");
+    ASSERT(personVar2 == personVar, "Mapped person does not match.");
+
+    std::cout << "Mapped file test passed." << std::endl;
+}
+
+void test_serialized_size() {
+    std::vector<std::string> vectorVarStr = {"bob and john,", "leo,", "hi,"};
+    std::vector<int64_t> vectorVar = {1, -2, 300, -40000};
+    std::map<int, std::list<float>> mapVar = {{1, {1.1f, 2.2f}}, {2, {}}};
+    std::set<uint16_t> setVar = {1, 200, 60000};
+    std::vector<Person> personsVar = {Person("Leo Ding", 30, 1.75), Person("Bob", 40, 1.8)};
+    std::shared_ptr<int[]> sptr(new int[3]{1, 2, 3});
+
+    BinaryFormat compact;
+    compact.compact_lengths = true;
+    compact.varint_integers = true;
+
+    for (const BinaryFormat& format : {BinaryFormat(), compact}) {
+        std::ostringstream oss;
+        BinaryWriter writer(oss);
+        writer.set_format(format);
+        size_t expected = 0;
+
+        serialize(vectorVarStr, writer);
+        expected += serialized_size(vectorVarStr, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(vector(string)) does not match.");
+        serialize(vectorVar, writer);
+        expected += serialized_size(vectorVar, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(vector(int64)) does not match.");
+        serialize(mapVar, writer);
+        expected += serialized_size(mapVar, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(map) does not match.");
+        serialize(setVar, writer);
+        expected += serialized_size(setVar, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(set) does not match.");
+        serialize(personsVar, writer);
+        expected += serialized_size(personsVar, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(vector(Person)) does not match.");
+        serialize(sptr, writer, 3);
+        expected += serialized_size(sptr, 3, format);
+        ASSERT(writer.bytes_written() == expected, "serialized_size(shared_ptr) does not match.");
+    }
+
+    std::cout << "Serialized size test passed." << std::endl;
+}
+
+void test_serialize_into_span() {
+    std::map<std::string, double> mapVar = {{"a", 1.5}, {"bc", 2.5}};
+    Person personVar("Leo Ding", 30, 1.75);
+    auto uptr = std::make_unique<int[]>(4);
+
+    // Exactly sized buffer: everything fits and the bytes match the stream output
+    std::vector<std::byte> buffer(serialized_size(mapVar));
+    std::optional<size_t> used = serialize_into(mapVar, std::span<std::byte>(buffer));
+    ASSERT(used && *used == buffer.size(), "serialize_into did not fill the exact buffer.");
+    std::ostringstream oss;
+    serialize(mapVar, oss);
+    ASSERT(std::memcmp(buffer.data(), oss.str().data(), buffer.size()) == 0, "serialize_into bytes do not match.");
+
+    // A buffer one byte short fails cleanly
+    std::byte small[64];
+    size_t needed = serialized_size(personVar);
+    ASSERT(needed <= sizeof(small), "Person unexpectedly large.");
+    ASSERT(!serialize_into(personVar, std::span<std::byte>(small, needed - 1)), "serialize_into accepted a short buffer.");
+    ASSERT(serialize_into(personVar, std::span<std::byte>(small)) == needed, "serialize_into(Person) size does not match.");
+    ASSERT(serialize_into(uptr, 4, std::span<std::byte>(small)) == sizeof(size_t) + 4 * sizeof(int), "serialize_into(unique_ptr) size does not match.");
+
+    std::cout << "Serialize into span test passed." << std::endl;
+}
+
+void test_user_type_archives() {
+    std::vector<Person> personsVar = {Person("Leo Ding", 30, 1.75), Person("Bob", 40, 1.8)};
+    Reading readingVar{1700000000, {1, -2, 300}};
+
+    BinaryFormat compact;
+    compact.compact_lengths = true;
+    compact.varint_integers = true;
+
+    // A type with only stream members goes through a stream over the archive, in the default format
+    std::ostringstream expected;
+    serialize(personsVar[0], expected);
+    ASSERT(serialized_size(personsVar[0], compact) == expected.str().size(), "Stream-only type was not counted in the default format.");
+    std::byte bytes[64];
+    ASSERT(serialize_into(personsVar[0], std::span<std::byte>(bytes), compact) == expected.str().size(), "Stream-only type size does not match.");
+    ASSERT(std::memcmp(bytes, expected.str().data(), expected.str().size()) == 0, "Stream-only type bytes do not match.");
+
+    std::ostringstream oss;
+    {
+        BinaryWriter writer(oss);
+        writer.set_format(compact);
+        serialize(personsVar, writer);
+        serialize(readingVar, writer);
+        ASSERT(writer.bytes_written() == serialized_size(personsVar, compact) + serialized_size(readingVar, compact),
+               "User type sizes do not match the writer.");
+    }
+    const std::string data = oss.str();
+
+    // A type with member templates is written in the archive's format
+    ASSERT(serialized_size(readingVar, compact) < serialized_size(readingVar), "Member template type ignored the archive format.");
+
+    std::vector<Person> personsVar2;
+    Reading readingVar2;
+    BinaryReader reader(data.data(), data.size());
+    reader.set_format(compact);
+    deserialize(personsVar2, reader);
+    deserialize(readingVar2, reader);
+    ASSERT(reader.eof(), "BinaryReader did not consume the user types.");
+    ASSERT(personsVar2 == personsVar, "Stream-only type does not match.");
+    ASSERT(readingVar2 == readingVar, "Member template type does not match.");
+
+    std::cout << "User type archive test passed." << std::endl;
+}
+
+void test_sorted_containers() {
+    std::map<int, std::string> mapVar;
+    std::set<std::string> setVar;
+    for (int i = 0; i < 1000; ++i) {
+        mapVar.emplace(i * 3, std::to_string(i));
+        setVar.insert(std::to_string(i));
+    }
+
+    std::ostringstream oss;
+    serialize(mapVar, oss);
+    serialize(setVar, oss);
+    const std::string bytes = oss.str();
+
+    // Targets that already hold data are replaced, not merged
+    std::map<int, std::string> mapVar2 = {{-1, "stale"}};
+    std::set<std::string> setVar2 = {"stale"};
+    BinaryReader reader(bytes.data(), bytes.size());
+    deserialize(mapVar2, reader);
+    deserialize(setVar2, reader);
+    ASSERT(mapVar2 == mapVar, "Deserialized map does not match.");
+    ASSERT(setVar2 == setVar, "Deserialized set does not match.");
+
+    // Out of order input is rejected
+    std::ostringstream unsorted;
+    serialize(std::vector<int>{1, 3, 2}, unsorted);
+    std::istringstream iss(unsorted.str());
+    std::set<int> setVar3;
+    bool threw = false;
+    try {
+        deserialize(setVar3, iss);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Unsorted set input was accepted.");
+
+    std::cout << "Sorted container test passed." << std::endl;
+}
+
 void test_binary_serialization() {
     // Initialize various variables
     int intVar = 42;
@@ -290,11 +864,747 @@ void test_xml_serialization() {
     std::cout << "XML serialization test passed." << std::endl;
 }
 
+void test_xml_archive() {
+    std::remove("archive.xml");
+
+    // Many values into one document, saved once
+    {
+        XMLArchive archive("archive.xml");
+        for (int i = 0; i < 100; ++i) {
+            serialize_xml(i, "int" + std::to_string(i), archive);
+        }
+        serialize_xml(std::string("Hello, World!"), "string", archive);
+        serialize_xml(std::vector<double>{1.5, 2.5}, "vector", archive);
+        serialize_xml(std::map<int, std::string>{{1, "a"}, {2, "b"}}, "map", archive);
+        serialize_xml(Person("Leo Ding", 30, 1.75), "Person", archive);
+        archive.commit();
+    }
+
+    // And read back from one parsed document
+    XMLArchive archive("archive.xml", XMLArchive::READ);
+    for (int i = 0; i < 100; ++i) {
+        int value = -1;
+        deserialize_xml(value, "int" + std::to_string(i), archive);
+        ASSERT(value == i, "XMLArchive int does not match.");
+    }
+    std::string stringVar;
+    std::vector<double> vectorVar;
+    std::map<int, std::string> mapVar;
+    Person personVar;
+    deserialize_xml(stringVar, "string", archive);
+    deserialize_xml(vectorVar, "vector", archive);
+    deserialize_xml(mapVar, "map", archive);
+    deserialize_xml(personVar, "Person", archive);
+    ASSERT(stringVar == "Hello, World!", "XMLArchive string does not match.");
+    ASSERT((vectorVar == std::vector<double>{1.5, 2.5}), "XMLArchive vector does not match.");
+    ASSERT((mapVar == std::map<int, std::string>{{1, "a"}, {2, "b"}}), "XMLArchive map does not match.");
+    ASSERT(personVar == Person("Leo Ding", 30, 1.75), "XMLArchive person does not match.");
+
+    // Lookups keep FirstChildElement semantics as entries are added: containers go first, the rest last
+    XMLArchive update("archive.xml");
+    int intVar = -1;
+    deserialize_xml(intVar, "int0", update);
+    serialize_xml(std::vector<double>{3.5}, "vector", update);
+    serialize_xml(7, "int0", update);
+    serialize_xml(8, "int100", update);
+    deserialize_xml(vectorVar, "vector", update);
+    deserialize_xml(intVar, "int0", update);
+    ASSERT((vectorVar == std::vector<double>{3.5}), "XMLArchive index missed a container inserted first.");
+    ASSERT(intVar == 0, "XMLArchive index did not keep the first entry.");
+    deserialize_xml(intVar, "int100", update);
+    ASSERT(intVar == 8, "XMLArchive index missed an entry inserted last.");
+
+    std::cout << "XML archive test passed." << std::endl;
+}
+
+void test_xml_number_format() {
+    char buf[200];
+    XMLUtil::ToStr(3.14159, buf, sizeof(buf));
+    ASSERT(std::string(buf) == "3.14159", "double is not written in shortest form.");
+    XMLUtil::ToStr(1.1f, buf, sizeof(buf));
+    ASSERT(std::string(buf) == "1.1", "float is not written in shortest form.");
+    XMLUtil::ToStr(static_cast<int64_t>(-1234567890123LL), buf, sizeof(buf));
+    ASSERT(std::string(buf) == "-1234567890123", "int64 is not written correctly.");
+
+    // Shortest output must still read back to the same value
+    for (double v : {0.1, 1.0 / 3.0, 1e-300, 6.02214076e23, -2.5e-7, std::numeric_limits<double>::max()}) {
+        double back = 0;
+        XMLUtil::ToStr(v, buf, sizeof(buf));
+        ASSERT(XMLUtil::ToDouble(buf, &back) && back == v, "double does not round-trip.");
+    }
+
+    XMLDocument doc;
+    XMLElement* element = doc.NewElement("e");
+    element->SetAttribute("val", 3.14159);
+    element->SetText(0.1);
+    ASSERT(std::string(element->Attribute("val")) == "3.14159", "SetAttribute(double) is not in shortest form.");
+    ASSERT(std::string(element->GetText()) == "0.1", "SetText(double) is not in shortest form.");
+
+    std::cout << "XML number format test passed." << std::endl;
+}
+
+void test_xml_number_parse() {
+    int intVar = 0;
+    unsigned unsignedVar = 0;
+    int64_t int64Var = 0;
+    double doubleVar = 0;
+    bool boolVar = false;
+    ASSERT(XMLUtil::ToInt("  +42", &intVar) && intVar == 42, "ToInt does not accept white space and '+'.");
+    ASSERT(XMLUtil::ToInt("0x1F", &intVar) && intVar == 31, "ToInt does not accept hex.");
+    ASSERT(XMLUtil::ToUnsigned("0XfF", &unsignedVar) && unsignedVar == 255, "ToUnsigned does not accept hex.");
+    ASSERT(XMLUtil::ToInt64("-9000000000 trailing", &int64Var) && int64Var == -9000000000LL, "ToInt64 does not ignore trailing text.");
+    ASSERT(XMLUtil::ToDouble(" 2.5e-3", &doubleVar) && doubleVar == 2.5e-3, "ToDouble does not parse.");
+    ASSERT(XMLUtil::ToBool("True", &boolVar) && boolVar, "ToBool does not accept 'True'.");
+    ASSERT(!XMLUtil::ToInt("abc", &intVar) && !XMLUtil::ToInt("+-1", &intVar), "ToInt accepted garbage.");
+    ASSERT(!XMLUtil::ToInt("99999999999", &intVar), "ToInt accepted an out of range value.");
+
+    // deserialize_xml shares the same parser, including bools and range checks
+    std::remove("parse.xml");
+    {
+        XMLArchive archive("parse.xml");
+        serialize_xml(true, "bool", archive);
+        serialize_xml(std::vector<double>{0.1, -1e10}, "vector", archive);
+        serialize_xml(70000, "big", archive);
+    }
+    XMLArchive archive("parse.xml", XMLArchive::READ);
+    std::vector<double> vectorVar;
+    short shortVar = 0;
+    deserialize_xml(boolVar = false, "bool", archive);
+    deserialize_xml(vectorVar, "vector", archive);
+    ASSERT(boolVar, "Deserialized bool does not match.");
+    ASSERT((vectorVar == std::vector<double>{0.1, -1e10}), "Deserialized vector(double) does not match.");
+    bool threw = false;
+    try {
+        deserialize_xml(shortVar, "big", archive);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Out of range XML value was accepted.");
+
+    std::cout << "XML number parse test passed." << std::endl;
+}
+
+void test_xml_packed_numbers() {
+    std::vector<int> vectorVar = {3, -1, 4, 1, -5, 9};
+    std::list<double> listVar = {0.1, -2.5e300, 1e-7};
+    std::set<uint64_t> setVar = {0, 42, std::numeric_limits<uint64_t>::max()};
+    std::vector<std::string> stringVar = {"packed", "is", "numbers only"};
+    std::vector<float> emptyVar;
+    std::remove("packed.xml");
+    {
+        XMLArchive archive("packed.xml", XMLArchive::UPDATE, XMLFormat{true});
+        serialize_xml(vectorVar, "vector", archive);
+        serialize_xml(listVar, "list", archive);
+        serialize_xml(setVar, "set", archive);
+        serialize_xml(stringVar, "strings", archive);
+        serialize_xml(emptyVar, "empty", archive);
+        ASSERT(archive.find("vector")->GetText() == std::string("3 -1 4 1 -5 9"), "Vector was not packed.");
+        ASSERT(!archive.find("vector")->FirstChildElement(), "Packed vector has per-item children.");
+        ASSERT(archive.find("strings")->FirstChildElement("element"), "String vector was packed.");
+    }
+
+    // a default archive reads the packed layout back without being told
+    XMLArchive archive("packed.xml", XMLArchive::READ);
+    std::vector<int> newVectorVar = {7};
+    std::list<double> newListVar;
+    std::set<uint64_t> newSetVar;
+    std::vector<std::string> newStringVar;
+    std::vector<float> newEmptyVar = {1.0f};
+    deserialize_xml(newVectorVar, "vector", archive);
+    deserialize_xml(newListVar, "list", archive);
+    deserialize_xml(newSetVar, "set", archive);
+    deserialize_xml(newStringVar, "strings", archive);
+    deserialize_xml(newEmptyVar, "empty", archive);
+    ASSERT(vectorVar == newVectorVar, "Deserialized packed vector does not match.");
+    ASSERT(listVar == newListVar, "Deserialized packed list does not match.");
+    ASSERT(setVar == newSetVar, "Deserialized packed set does not match.");
+    ASSERT(stringVar == newStringVar, "Deserialized string vector does not match.");
+    ASSERT(newEmptyVar.empty(), "Deserialized packed empty vector is not empty.");
+
+    XMLDocument& doc = archive.document();
+    XMLElement* bad = doc.NewElement("bad");
+    bad->SetText("1 2x 3");
+    archive.insert_last(bad);
+    std::vector<short> badVar;
+    bool threw = false;
+    try {
+        deserialize_xml(badVar, "bad", archive);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Malformed packed run was accepted.");
+
+    std::cout << "XML packed numbers test passed." << std::endl;
+}
+
+void test_xml_base64_blobs() {
+    // every tail length and every byte value goes through the encoder and decoder
+    std::string bytes;
+    for (int i = 0; i < 256; ++i) {
+        bytes.push_back(static_cast<char>(i));
+    }
+    for (size_t n = 0; n <= bytes.size(); n += 37) {
+        for (size_t size : {n, n + 1, n + 2}) {
+            std::string text = XMLSerialization::base64::encode(bytes.data(), std::min(size, bytes.size()));
+            std::string decoded(XMLSerialization::base64::decoded_size(text.data(), text.size()), '\0');
+            ASSERT(XMLSerialization::base64::decode(text.data(), text.size(), decoded.data()), "Base64 decoding failed.");
+            ASSERT(decoded == bytes.substr(0, std::min(size, bytes.size())), "Base64 round trip does not match.");
+        }
+    }
+    ASSERT(XMLSerialization::base64::encode("foobar", 4) == "Zm9vYg==", "Base64 encoding does not match RFC 4648.");
+    char scratch[8];
+    ASSERT(!XMLSerialization::base64::decode("Zm9v!mE=", 8, scratch), "Base64 decoding accepted an invalid character.");
+    ASSERT(!XMLSerialization::base64::decode("Zm9vYh==", 8, scratch), "Base64 decoding accepted nonzero padding bits.");
+
+    std::vector<float> vectorVar(1000);
+    for (size_t i = 0; i < vectorVar.size(); ++i) {
+        vectorVar[i] = static_cast<float>(i) * 0.37f - 100.0f;
+    }
+    std::unique_ptr<int16_t[]> uptr(new int16_t[5]{-3, 0, 7, 32767, -32768});
+    std::shared_ptr<double[]> sptr(new double[3]{0.1, -2.5, 1e300});
+    std::vector<std::string> stringVar = {"stays", "readable"};
+    std::remove("blob.xml");
+    {
+        XMLFormat format;
+        format.base64_blobs = true;
+        XMLArchive archive("blob.xml", XMLArchive::UPDATE, format);
+        serialize_xml(vectorVar, "vector", archive);
+        serialize_xml(uptr, "unique_ptr", archive, 5);
+        serialize_xml(sptr, "shared_ptr", archive, 3);
+        serialize_xml(stringVar, "strings", archive);
+        XMLElement* blob = archive.find("vector");
+        ASSERT(blob->Attribute("type", "float32") && blob->UnsignedAttribute("count") == 1000, "Blob does not declare its type and count.");
+        ASSERT(archive.find("strings")->FirstChildElement("element"), "String vector was written as a blob.");
+    }
+
+    XMLArchive archive("blob.xml", XMLArchive::READ);
+    std::vector<float> newVectorVar;
+    std::unique_ptr<int16_t[]> newUptr;
+    std::shared_ptr<double[]> newSptr;
+    std::vector<std::string> newStringVar;
+    deserialize_xml(newVectorVar, "vector", archive);
+    deserialize_xml(newUptr, "unique_ptr", archive);
+    deserialize_xml(newSptr, "shared_ptr", archive);
+    deserialize_xml(newStringVar, "strings", archive);
+    ASSERT(vectorVar == newVectorVar, "Deserialized blob vector does not match.");
+    ASSERT(std::equal(uptr.get(), uptr.get() + 5, newUptr.get()), "Deserialized blob unique_ptr does not match.");
+    ASSERT(std::equal(sptr.get(), sptr.get() + 3, newSptr.get()), "Deserialized blob shared_ptr does not match.");
+    ASSERT(stringVar == newStringVar, "Deserialized string vector does not match.");
+
+    // a blob is only read back into the element type it declares
+    std::vector<double> wrongVar;
+    bool threw = false;
+    try {
+        deserialize_xml(wrongVar, "vector", archive);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Blob was read into a different element type.");
+
+    std::cout << "XML base64 blob test passed." << std::endl;
+}
+
+// A user type that prints itself, for the stream archive
+struct Stamp {
+    int id = 0;
+    void serialize_xml(tinyxml2::XMLPrinter& printer) const {
+        printer.PushAttribute("id", id);
+    }
+    void deserialize_xml(const tinyxml2::XMLElement& element) {
+        id = element.IntAttribute("id");
+    }
+};
+
+void test_xml_stream_archive() {
+    std::vector<int> vectorVar = {1, 2, 3};
+    std::list<std::string> listVar = {"a", "<b>"};
+    std::set<double> setVar = {0.5, 1.5};
+    std::map<std::string, int> mapVar = {{"x", 1}, {"y", 2}};
+    std::unique_ptr<float[]> uptr(new float[2]{0.1f, -7.0f});
+    std::remove("stream.xml");
+    {
+        XMLStreamArchive archive("stream.xml");
+        serialize_xml(42, "int", archive);
+        serialize_xml('c', "char", archive);
+        serialize_xml(0.1f, "float", archive);
+        serialize_xml(std::string("Hello & bye"), "string", archive);
+        serialize_xml(vectorVar, "vector", archive);
+        serialize_xml(listVar, "list", archive);
+        serialize_xml(setVar, "set", archive);
+        serialize_xml(std::make_pair(1, std::string("one")), "pair", archive);
+        serialize_xml(mapVar, "map", archive);
+        serialize_xml(uptr, "unique_ptr", archive, 2);
+        serialize_xml(Person("Leo Ding", 30, 1.75), "Person", archive);
+        serialize_xml(Stamp{7}, "Stamp", archive);
+        archive.close();
+    }
+
+    XMLArchive archive("stream.xml", XMLArchive::READ);
+    int intVar = 0;
+    char charVar = 0;
+    float floatVar = 0;
+    std::string stringVar;
+    std::vector<int> newVectorVar;
+    std::list<std::string> newListVar;
+    std::set<double> newSetVar;
+    std::pair<int, std::string> pairVar;
+    std::map<std::string, int> newMapVar;
+    std::unique_ptr<float[]> newUptr;
+    Person personVar;
+    Stamp stampVar;
+    deserialize_xml(intVar, "int", archive);
+    deserialize_xml(charVar, "char", archive);
+    deserialize_xml(floatVar, "float", archive);
+    deserialize_xml(stringVar, "string", archive);
+    deserialize_xml(newVectorVar, "vector", archive);
+    deserialize_xml(newListVar, "list", archive);
+    deserialize_xml(newSetVar, "set", archive);
+    deserialize_xml(pairVar, "pair", archive);
+    deserialize_xml(newMapVar, "map", archive);
+    deserialize_xml(newUptr, "unique_ptr", archive);
+    deserialize_xml(personVar, "Person", archive);
+    deserialize_xml(stampVar, "Stamp", archive);
+    ASSERT(intVar == 42 && charVar == 'c' && floatVar == 0.1f, "Streamed scalar does not match.");
+    ASSERT(stringVar == "Hello & bye", "Streamed string does not match.");
+    ASSERT(vectorVar == newVectorVar && listVar == newListVar && setVar == newSetVar, "Streamed container does not match.");
+    ASSERT(pairVar.first == 1 && pairVar.second == "one" && mapVar == newMapVar, "Streamed pair or map does not match.");
+    ASSERT(newUptr[0] == 0.1f && newUptr[1] == -7.0f, "Streamed unique_ptr does not match.");
+    ASSERT(personVar == Person("Leo Ding", 30, 1.75) && stampVar.id == 7, "Streamed user type does not match.");
+
+    // Entries an XMLArchive appends in call order come out byte for byte the same, in every layout
+    for (bool blobs : {false, true}) {
+        XMLFormat format;
+        format.packed_numbers = !blobs;
+        format.base64_blobs = blobs;
+        std::remove("stream.xml");
+        std::remove("dom.xml");
+        {
+            XMLStreamArchive stream("stream.xml", format);
+            XMLArchive dom("dom.xml", XMLArchive::UPDATE, format);
+            serialize_xml(3.25, "double", stream);
+            serialize_xml(3.25, "double", dom);
+            serialize_xml(mapVar, "map", stream);
+            serialize_xml(mapVar, "map", dom);
+            serialize_xml(uptr, "unique_ptr", stream, 2);
+            serialize_xml(uptr, "unique_ptr", dom, 2);
+            serialize_xml(Person("Leo Ding", 30, 1.75), "Person", stream);
+            serialize_xml(Person("Leo Ding", 30, 1.75), "Person", dom);
+        }
+        std::ifstream streamFile("stream.xml"), domFile("dom.xml");
+        std::stringstream streamText, domText;
+        streamText << streamFile.rdbuf();
+        domText << domFile.rdbuf();
+        ASSERT(streamText.str() == domText.str(), "Streamed document differs from the XMLArchive one.");
+    }
+
+    std::cout << "XML stream archive test passed." << std::endl;
+}
+
+void test_xml_pull_parser() {
+    // Events in document order, with entities decoded and markup that carries no data skipped
+    XMLPullParser parser;
+    ASSERT(parser.Parse("<?xml version=\"1.0\"?><!-- note --><a x='1 &amp; 2'> t&lt;xt <b/><![CDATA[<raw>]]></a>") == XML_SUCCESS, "Pull parser rejected the document.");
+    ASSERT(parser.Next() == XMLPullParser::START_ELEMENT && std::string(parser.Name()) == "a" && parser.Depth() == 1, "Expected the start of <a>.");
+    ASSERT(parser.Next() == XMLPullParser::ATTRIBUTE && std::string(parser.Name()) == "x" && std::string(parser.Value()) == "1 & 2", "Expected attribute x.");
+    ASSERT(parser.Next() == XMLPullParser::TEXT && std::string(parser.Value()) == " t<xt ", "Expected the text of <a>.");
+    ASSERT(parser.Next() == XMLPullParser::START_ELEMENT && std::string(parser.Name()) == "b" && parser.Depth() == 2, "Expected the start of <b>.");
+    ASSERT(parser.Next() == XMLPullParser::END_ELEMENT && std::string(parser.Name()) == "b", "Expected the end of sealed <b>.");
+    ASSERT(parser.Next() == XMLPullParser::TEXT && std::string(parser.Value()) == "<raw>", "Expected CDATA text.");
+    ASSERT(parser.Next() == XMLPullParser::END_ELEMENT && std::string(parser.Name()) == "a" && parser.Depth() == 1, "Expected the end of <a>.");
+    ASSERT(parser.Next() == XMLPullParser::END_DOCUMENT && parser.Next() == XMLPullParser::END_DOCUMENT, "Expected the end of the document.");
+
+    parser.Parse("<a><b></a></b>");
+    parser.Next();
+    parser.Next();
+    ASSERT(parser.Next() == XMLPullParser::PARSE_ERROR && parser.ErrorID() == XML_ERROR_MISMATCHED_ELEMENT, "Mismatched end tag was accepted.");
+
+    // deserialize_xml reads entries from a file through the pull parser, in every layout
+    std::remove("pull.xml");
+    std::vector<double> blobVar = {0.5, -1e-300, 3.0};
+    std::set<int> packedVar = {-4, 8, 15};
+    std::map<std::string, int> mapVar = {{"a", 1}, {"b", 2}};
+    {
+        XMLFormat format;
+        XMLArchive archive("pull.xml", XMLArchive::UPDATE, format);
+        serialize_xml(std::string("skip <me>"), "string", archive);
+        serialize_xml(mapVar, "map", archive);
+        format.base64_blobs = true;
+        archive.set_format(format);
+        serialize_xml(blobVar, "blob", archive);
+        format.packed_numbers = true;
+        format.base64_blobs = false;
+        archive.set_format(format);
+        serialize_xml(packedVar, "packed", archive);
+        serialize_xml('z', "char", archive);
+    }
+    std::vector<double> newBlobVar;
+    std::set<int> newPackedVar;
+    std::map<std::string, int> newMapVar;
+    std::string stringVar;
+    char charVar = 0;
+    deserialize_xml(newBlobVar, "blob", "pull.xml");
+    deserialize_xml(newPackedVar, "packed", "pull.xml");
+    deserialize_xml(newMapVar, "map", "pull.xml");
+    deserialize_xml(stringVar, "string", "pull.xml");
+    deserialize_xml(charVar, "char", "pull.xml");
+    ASSERT(blobVar == newBlobVar && packedVar == newPackedVar && mapVar == newMapVar, "Pulled container does not match.");
+    ASSERT(stringVar == "skip <me>" && charVar == 'z', "Pulled scalar does not match.");
+    bool threw = false;
+    try {
+        deserialize_xml(charVar, "missing", "pull.xml");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Missing entry was not reported.");
+
+    // Text split by a comment or a CDATA section is decoded as one run
+    {
+        std::ofstream ofs("pull.xml", std::ios::binary);
+        ofs << "<serialization><v encoding=\"base64\" type=\"uint8\" count=\"9\">AAAA<!--c-->AAAA<![CDATA[AAAA]]></v>"
+               "<p>1<!--c-->2 3<![CDATA[ 4]]></p></serialization>";
+    }
+    std::vector<uint8_t> splitBlobVar;
+    std::vector<int> splitPackedVar;
+    deserialize_xml(splitBlobVar, "v", "pull.xml");
+    deserialize_xml(splitPackedVar, "p", "pull.xml");
+    ASSERT(splitBlobVar == std::vector<uint8_t>(9, 0), "Split blob does not match.");
+    ASSERT(splitPackedVar == std::vector<int>({12, 3, 4}), "Split packed run does not match.");
+
+    std::cout << "XML pull parser test passed." << std::endl;
+}
+
+void test_xml_mapped_load() {
+    // A file that fills whole pages exactly still gets a null terminator after its text
+    std::string text = "<serialization><entry val=\"a &amp; b\"/><pad>";
+    const std::string tail = "</pad></serialization>";
+    text.append(8192 - text.size() - tail.size(), 'x');
+    text += tail;
+    {
+        std::ofstream ofs("mapped.xml", std::ios::binary);
+        ofs << text;
+    }
+    XMLDocument mapped, loaded;
+    ASSERT(mapped.LoadMappedFile("mapped.xml") == XML_SUCCESS, "Mapped load failed.");
+    ASSERT(loaded.LoadFile("mapped.xml") == XML_SUCCESS, "Load failed.");
+    XMLElement* mappedRoot = mapped.FirstChildElement("serialization");
+    XMLElement* loadedRoot = loaded.FirstChildElement("serialization");
+    ASSERT(mappedRoot && std::string(mappedRoot->FirstChildElement("entry")->Attribute("val")) == "a & b", "Mapped attribute does not match.");
+    ASSERT(std::string(mappedRoot->FirstChildElement("pad")->GetText()) == loadedRoot->FirstChildElement("pad")->GetText(), "Mapped text does not match.");
+
+    // Decoding in place writes to private pages only; the file is untouched
+    std::ifstream ifs("mapped.xml", std::ios::binary);
+    std::stringstream contents;
+    contents << ifs.rdbuf();
+    ASSERT(contents.str() == text, "Mapped load modified the file.");
+
+    ASSERT(mapped.LoadMappedFile("missing.xml") == XML_ERROR_FILE_NOT_FOUND, "Missing file was not reported.");
+    ASSERT(mapped.LoadMappedFile("mapped.xml") == XML_SUCCESS, "Mapped document could not be reloaded.");
+
+    // Only a MAPPED archive maps its file; a READ archive keeps its own copy, so the file may be rewritten under it
+    std::string value;
+    {
+        XMLArchive archive("mapped.xml", XMLArchive::MAPPED);
+        deserialize_xml(value, "entry", archive);
+        ASSERT(value == "a & b", "MAPPED archive read the wrong value.");
+    }
+    {
+        XMLArchive archive("mapped.xml", XMLArchive::READ);
+        std::ofstream("mapped.xml", std::ios::binary | std::ios::trunc) << "<serialization/>";
+        deserialize_xml(value, "entry", archive);
+        ASSERT(value == "a & b", "READ archive was affected by a rewrite of its file.");
+    }
+
+    std::cout << "XML mapped load test passed." << std::endl;
+}
+
+void test_xml_printer_buffer() {
+    // Output larger than the printer's buffer, written through stdio and through write(2),
+    // matches what the same document prints to memory
+    XMLDocument doc;
+    XMLElement* root = doc.NewElement("serialization");
+    doc.InsertFirstChild(root);
+    for (int i = 0; i < 5000; ++i) {
+        XMLElement* element = root->InsertNewChildElement("element");
+        element->SetAttribute("val", i);
+        element->SetText("some text & more");
+    }
+    root->InsertNewChildElement("long")->SetText(std::string(200000, 'x').c_str());
+    XMLPrinter memory;
+    doc.Print(&memory);
+
+    for (bool direct : {false, true}) {
+        FILE* fp = fopen("printer.xml", "wb");
+        {
+            XMLPrinter printer(fp);
+            printer.SetBuffered(true);
+            printer.SetDirectWrite(direct);
+            doc.Print(&printer);
+            ASSERT(!printer.WriteError(), "Printer reported a write error.");
+        }
+        fclose(fp);
+        std::ifstream ifs("printer.xml", std::ios::binary);
+        std::stringstream contents;
+        contents << ifs.rdbuf();
+        ASSERT(contents.str() == memory.CStr(), "Buffered file output does not match the memory output.");
+    }
+
+    // Without buffering the output is in the FILE* as soon as it is printed,
+    // so the file can be closed and read back while the printer is still alive
+    {
+        FILE* fp = fopen("printer.xml", "wb");
+        XMLPrinter printer(fp);
+        doc.Print(&printer);
+        fclose(fp);
+        std::ifstream ifs("printer.xml", std::ios::binary);
+        std::stringstream contents;
+        contents << ifs.rdbuf();
+        ASSERT(contents.str() == memory.CStr(), "Unbuffered file output is not complete while the printer is alive.");
+    }
+
+    std::cout << "XML printer buffer test passed." << std::endl;
+}
+
+void test_xml_simd_scanning() {
+    // White space, names and text runs of every length up to a few blocks, starting at every
+    // offset within a block, parse to the same values and line numbers as a byte-at-a-time scan
+    for (int run = 0; run < 70; ++run) {
+        for (int offset = 0; offset < 32; ++offset) {
+            const std::string name = "n" + std::string(run, 'a' + run % 26) + "-9.\xc3\xa9";
+            const std::string space = std::string(offset, ' ') + std::string(run % 5, '\n') + std::string(run, '\t');
+            std::string text = std::string(run, 'x') + "\n<" + std::string(offset, 'y') + "]]";
+            const std::string xml = space + "<" + name + " " + name + "='v'" + space + ">" + space
+                + "<![CDATA[" + text + "]]></" + name + ">" + space + "<last/>";
+            XMLDocument doc;
+            ASSERT(doc.Parse(xml.c_str()) == XML_SUCCESS, "SIMD scanning parse failed.");
+            XMLElement* element = doc.FirstChildElement();
+            ASSERT(element && name == element->Name(), "Scanned name does not match.");
+            ASSERT(std::string(element->Attribute(name.c_str())) == "v", "Scanned attribute does not match.");
+            ASSERT(element->GetText() && text == element->GetText(), "Scanned text does not match.");
+
+            const int lines = 1 + run % 5;
+            ASSERT(element->GetLineNum() == lines, "Element line number does not match.");
+            ASSERT(doc.FirstChildElement("last")->GetLineNum() == 1 + 4 * (run % 5) + 1, "Line number after the text does not match.");
+        }
+    }
+
+    // An unterminated text run reports an error instead of reading past the end
+    XMLDocument doc;
+    ASSERT(doc.Parse("<a><![CDATA[ ] ]] ]>") != XML_SUCCESS, "Unterminated CDATA was accepted.");
+    ASSERT(doc.Parse("<a>  \n  ") != XML_SUCCESS, "Unterminated element was accepted.");
+
+    std::cout << "XML SIMD scanning test passed." << std::endl;
+}
+
+void test_xml_printer_escaping() {
+    // Entities at every position of strings a few blocks long are escaped exactly once;
+    // text escapes & < >, attributes also escape both quotes
+    const std::string specials = "&<>\"'";
+    for (int length = 0; length < 80; ++length) {
+        for (size_t s = 0; s < specials.size(); ++s) {
+            std::string value(length, 'v');
+            std::string text, attribute;
+            for (int i = 0; i < length; ++i) {
+                if (i % (s + 7) == 3) {
+                    value[i] = specials[s];
+                }
+            }
+            value += "\xc3\xa9 end";
+            for (char c : value) {
+                switch (c) {
+                    case '&': text += "&amp;"; attribute += "&amp;"; break;
+                    case '<': text += "&lt;"; attribute += "&lt;"; break;
+                    case '>': text += "&gt;"; attribute += "&gt;"; break;
+                    case '"': text += c; attribute += "&quot;"; break;
+                    case '\'': text += c; attribute += "&apos;"; break;
+                    default: text += c; attribute += c;
+                }
+            }
+            XMLPrinter printer(0, true);
+            printer.OpenElement("e");
+            printer.PushAttribute("a", value.c_str());
+            printer.PushText(value.c_str());
+            printer.CloseElement();
+            ASSERT(std::string(printer.CStr()) == "<e a=\"" + attribute + "\">" + text + "</e>\n", "Escaped output does not match.");
+
+            XMLDocument doc;
+            ASSERT(doc.Parse(printer.CStr()) == XML_SUCCESS, "Escaped output could not be parsed.");
+            ASSERT(value == doc.FirstChildElement("e")->Attribute("a") && value == doc.FirstChildElement("e")->GetText(), "Escaped value does not round-trip.");
+
+            // A caller string is read no further than its terminator, even when that ends mid-block
+            std::unique_ptr<char[]> exact(new char[value.size() + 1]);
+            std::memcpy(exact.get(), value.c_str(), value.size() + 1);
+            XMLPrinter exactPrinter(0, true);
+            exactPrinter.PushText(exact.get());
+            ASSERT(std::string(exactPrinter.CStr()) == text, "Escaped text of an exactly sized string does not match.");
+        }
+    }
+
+    std::cout << "XML printer escaping test passed." << std::endl;
+}
+
+void test_xml_shared_archive() {
+    // Strings that only decode on first read: entities, character references and collapsed whitespace
+    XMLDocument doc(true, COLLAPSE_WHITESPACE);
+    doc.SetNormalizeOnParse(true);
+    ASSERT(doc.Parse("<root a=\"x &amp; &#65;\">  two\n  words  <b/></root>") == XML_SUCCESS, "Normalized parse failed.");
+    const XMLElement* root = doc.FirstChildElement("root");
+    ASSERT(std::string(root->Attribute("a")) == "x & A" && std::string(root->GetText()) == "two words", "Normalized strings do not match.");
+
+    std::remove("shared.xml");
+    {
+        XMLArchive archive("shared.xml");
+        for (int i = 0; i < 50; ++i) {
+            serialize_xml("<" + std::to_string(i) + "> & \"quoted\"", "string" + std::to_string(i), archive);
+        }
+        serialize_xml(std::map<std::string, int>{{"a&b", 1}, {"c<d", 2}}, "map", archive);
+        serialize_xml(Person("Leo Ding", 30, 1.75), "Person", archive);
+    }
+
+    // Every thread reads every entry from the same archive
+    XMLArchive archive("shared.xml", XMLArchive::SHARED);
+    std::vector<std::thread> workers;
+    std::vector<int> mismatches(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&archive, &mismatches, t] {
+            for (int i = 0; i < 50; ++i) {
+                std::string value;
+                deserialize_xml(value, "string" + std::to_string(i), archive);
+                mismatches[t] += value != "<" + std::to_string(i) + "> & \"quoted\"";
+            }
+            std::map<std::string, int> mapVar;
+            Person personVar;
+            deserialize_xml(mapVar, "map", archive);
+            deserialize_xml(personVar, "Person", archive);
+            mismatches[t] += mapVar != std::map<std::string, int>{{"a&b", 1}, {"c<d", 2}};
+            mismatches[t] += !(personVar == Person("Leo Ding", 30, 1.75));
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    ASSERT(std::count(mismatches.begin(), mismatches.end(), 0) == 4, "Shared archive values do not match.");
+
+    bool threw = false;
+    try {
+        XMLArchive missing("missing.xml", XMLArchive::SHARED);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ASSERT(threw, "Missing shared archive was not reported.");
+
+    std::cout << "XML shared archive test passed." << std::endl;
+}
+
+void test_xml_name_interning() {
+    // Parsed and created names share one copy per document
+    XMLDocument doc;
+    ASSERT(doc.Parse("<root><pair first=\"1\" second=\"2\"/><pair first=\"3\" second=\"4\"/></root>") == XML_SUCCESS, "Interning parse failed.");
+    XMLElement* root = doc.FirstChildElement("root");
+    XMLElement* a = root->FirstChildElement("pair");
+    XMLElement* b = a->NextSiblingElement("pair");
+    XMLElement* c = doc.NewElement("pair");
+    c->SetAttribute("second", 6);
+    c->SetAttribute("first", 5);
+    root->InsertEndChild(c);
+    ASSERT(b && a->Name() == b->Name() && b->Name() == c->Name(), "Element names are not interned.");
+    ASSERT(a->FirstAttribute()->Name() == c->FirstAttribute()->Next()->Name(), "Attribute names are not interned.");
+    ASSERT(root->LastChildElement("pair") == c && c->PreviousSiblingElement("pair") == b, "Interned element lookup failed.");
+    ASSERT(c->IntAttribute("first") == 5 && b->IntAttribute("second") == 4, "Interned attribute lookup failed.");
+
+    // Lookups of names the document never saw, renaming, and deletion
+    ASSERT(!root->FirstChildElement("missing") && !a->Attribute("missing"), "Unknown name was found.");
+    b->SetName("other");
+    ASSERT(a->NextSiblingElement("pair") == c && root->FirstChildElement("other") == b, "Renamed element lookup failed.");
+    a->DeleteAttribute("first");
+    a->DeleteAttribute("missing");
+    ASSERT(!a->Attribute("first") && a->Attribute("second"), "Attribute deletion failed.");
+
+    // Names survive in a clone, interned by the target document, and the
+    // mismatched end tag check still compares by name
+    XMLDocument copy;
+    doc.DeepCopy(&copy);
+    ASSERT(copy.FirstChildElement("root")->LastChildElement("pair")->IntAttribute("first") == 5, "Cloned lookup failed.");
+    ASSERT(copy.Parse("<a><b></a></b>") == XML_ERROR_MISMATCHED_ELEMENT, "Mismatched end tag was accepted.");
+    ASSERT(copy.Parse("<a x=\"1\" y=\"2\" x=\"3\"/>") == XML_ERROR_PARSING_ATTRIBUTE, "Duplicate attribute was accepted.");
+
+    std::cout << "XML name interning test passed." << std::endl;
+}
+
+void test_xml_document_reuse() {
+    // A reset document parses larger, smaller and mapped inputs in turn
+    XMLDocument doc;
+    std::string large = "<root>";
+    for (int i = 0; i < 1000; ++i) {
+        large += "<item val=\"" + std::to_string(i) + "\"/>";
+    }
+    large += "</root>";
+    for (int round = 0; round < 3; ++round) {
+        ASSERT(doc.Parse(large.c_str()) == XML_SUCCESS, "Large parse failed.");
+        ASSERT(doc.RootElement()->LastChildElement("item")->IntAttribute("val") == 999, "Large document does not match.");
+        doc.Reset();
+        ASSERT(!doc.FirstChild(), "Reset document is not empty.");
+        ASSERT(doc.Parse("<small a=\"1\"/>") == XML_SUCCESS && doc.RootElement()->IntAttribute("a") == 1, "Small document does not match.");
+        ASSERT(doc.Parse("<broken>") != XML_SUCCESS, "Broken document was accepted.");
+    }
+    {
+        std::ofstream ofs("reuse.xml");
+        ofs << large;
+    }
+    ASSERT(doc.LoadMappedFile("reuse.xml") == XML_SUCCESS && doc.RootElement()->FirstChildElement("item"), "Mapped load after reuse failed.");
+    ASSERT(doc.LoadFile("reuse.xml") == XML_SUCCESS && doc.RootElement()->LastChildElement("item"), "Load after mapped load failed.");
+    doc.Clear();
+    ASSERT(doc.Parse("<again/>") == XML_SUCCESS, "Parse after clear failed.");
+
+    // Archives opened one after another on a thread share one pooled document
+    XMLDocumentPool::clear();
+    std::remove("reuse.xml");
+    const XMLDocument* first = nullptr;
+    for (int i = 0; i < 10; ++i) {
+        serialize_xml(std::vector<std::string>{"a", "b & c"}, "strings" + std::to_string(i), "reuse.xml");
+        XMLArchive archive("reuse.xml", XMLArchive::READ);
+        if (!first) {
+            first = &archive.document();
+        }
+        ASSERT(&archive.document() == first, "Archive did not reuse the pooled document.");
+        std::vector<std::string> strings;
+        deserialize_xml(strings, "strings" + std::to_string(i), archive);
+        ASSERT(strings.size() == 2 && strings[1] == "b & c", "Pooled archive value does not match.");
+    }
+    XMLDocumentPool::clear();
+
+    std::cout << "XML document reuse test passed." << std::endl;
+}
 
 int main() {
     try {
         test_binary_serialization();
+        test_binary_writer();
+        test_binary_reader();
+        test_corrupt_counts();
+        test_block_serialization();
+        test_compact_lengths();
+        test_varint_integers();
+        test_zero_copy_views();
+        test_mapped_file();
+        test_serialized_size();
+        test_serialize_into_span();
+        test_user_type_archives();
+        test_sorted_containers();
         test_xml_serialization();
+        test_xml_archive();
+        test_xml_number_format();
+        test_xml_number_parse();
+        test_xml_packed_numbers();
+        test_xml_base64_blobs();
+        test_xml_stream_archive();
+        test_xml_pull_parser();
+        test_xml_mapped_load();
+        test_xml_printer_buffer();
+        test_xml_simd_scanning();
+        test_xml_printer_escaping();
+        test_xml_shared_archive();
+        test_xml_name_interning();
+        test_xml_document_reuse();
         test_unique_ptr_serialization();
         test_shared_ptr_serialization();
     } catch (const std::bad_alloc& e) {
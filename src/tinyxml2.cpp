@@ -32,6 +32,19 @@ distribution.
 #   include <cstdarg>
 #endif
 
+#include <cerrno>
+#if !defined(_WIN32)
+#   include <unistd.h>
+#endif
+#if !defined(_WIN32) && !defined(TIXML_NO_MMAP)
+    // XMLDocument::LoadMappedFile maps the file instead of reading it
+#   define TIXML_USE_MMAP
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 ) && (!defined WINCE)
 	// Microsoft Visual Studio, version 2005 and higher. Not WinCE.
 	/*int _snprintf_s(
@@ -114,6 +127,20 @@ distribution.
 	#define TIXML_FTELL ftell
 #endif
 
+#if !defined(TIXML_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    // The parser's scanning loops look at 16 bytes at a time; SSE2 is part of every x86-64 CPU
+#   define TIXML_USE_SSE2
+#   include <emmintrin.h>
+#   if defined(__GNUC__) || defined(__clang__)
+        // 32 bytes at a time where the CPU turns out to support AVX2
+#       define TIXML_USE_AVX2
+#       include <immintrin.h>
+#   endif
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#endif
+
 
 static const char LINE_FEED				= static_cast<char>(0x0a);			// all line endings are normalized to LF
 static const char LF = LINE_FEED;
@@ -149,6 +176,338 @@ static const Entity entities[NUM_ENTITIES] = {
 };
 
 
+// --------- Scanning ----------- //
+//
+// The inner loops of the parser: skipping white space, finding the end of a text
+// run, and finding the end of a name; and of the printer: finding the next
+// character that has to be written as an entity. On x86 there are SSE2 and AVX2 versions
+// that test a whole block of bytes per step, picked once, on first use, from what the
+// CPU supports; elsewhere, or with TIXML_NO_SIMD, the plain loops are used.
+//
+// The block versions classify bytes as the C locale does: white space is 0x09-0x0d
+// and ' ', and name characters are ASCII letters and digits, ':', '_', '.', '-'
+// and every byte with the high bit set.
+//
+// The parser's scans stop at the terminator at the latest, but read the whole block
+// it is in. They are only used on the parsers' own buffers, which are allocated with
+// SCAN_PADDING zeroed bytes after the terminator. The printer's scan works on caller
+// strings, so it is given their end and finishes the last partial block a byte at a time.
+
+static const size_t SCAN_PADDING = 32;
+
+struct ScanFunctions {
+    // First character that is not white space, counting the newlines skipped
+    const char* (*skipWhiteSpace)( const char* p, int* curLineNumPtr );
+    // First occurrence of ch, or the terminator, counting the newlines passed
+    const char* (*findChar)( const char* p, char ch, int* curLineNumPtr );
+    // First character that cannot be part of a name
+    const char* (*nameEnd)( const char* p );
+    // First occurrence in [p, end) of any of the NUM_ENTITIES characters in set, or end;
+    // unused entries of set are 0
+    const char* (*findAny)( const char* p, const char* end, const char* set );
+};
+
+static const char* FindAnyScalar( const char* p, const char* end, const char* set )
+{
+    for( ; p < end; ++p ) {
+        for( int i=0; i<NUM_ENTITIES; ++i ) {
+            if ( *p == set[i] ) {
+                return p;
+            }
+        }
+    }
+    return p;
+}
+
+#ifndef TIXML_USE_SSE2
+
+static const char* SkipWhiteSpaceScalar( const char* p, int* curLineNumPtr )
+{
+    while( XMLUtil::IsWhiteSpace(*p) ) {
+        if (curLineNumPtr && *p == '\n') {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static const char* FindCharScalar( const char* p, char ch, int* curLineNumPtr )
+{
+    while ( *p && *p != ch ) {
+        if ( *p == '\n' ) {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static const char* NameEndScalar( const char* p )
+{
+    while ( *p && XMLUtil::IsNameChar( (unsigned char) *p ) ) {
+        ++p;
+    }
+    return p;
+}
+
+#endif // TIXML_USE_SSE2
+
+#ifdef TIXML_USE_SSE2
+
+static inline int LowestBit( unsigned mask )
+{
+    TIXMLASSERT( mask );
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz( mask );
+#endif
+}
+
+static inline int CountBits( unsigned mask )
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int count = 0;
+    for ( ; mask; mask &= mask - 1 ) {
+        ++count;
+    }
+    return count;
+#else
+    return __builtin_popcount( mask );
+#endif
+}
+
+static inline __m128i WhiteSpace16( __m128i c )
+{
+    // 0x09-0x0d is the range c - 0x09 <= 4, unsigned
+    const __m128i x = _mm_sub_epi8( c, _mm_set1_epi8( 0x09 ) );
+    const __m128i control = _mm_cmpeq_epi8( _mm_min_epu8( x, _mm_set1_epi8( 4 ) ), x );
+    return _mm_or_si128( control, _mm_cmpeq_epi8( c, _mm_set1_epi8( ' ' ) ) );
+}
+
+static inline __m128i NameChar16( __m128i c )
+{
+    const __m128i lower = _mm_sub_epi8( _mm_or_si128( c, _mm_set1_epi8( 0x20 ) ), _mm_set1_epi8( 'a' ) );
+    const __m128i letter = _mm_cmpeq_epi8( _mm_min_epu8( lower, _mm_set1_epi8( 25 ) ), lower );
+    const __m128i digit0 = _mm_sub_epi8( c, _mm_set1_epi8( '0' ) );
+    const __m128i digit = _mm_cmpeq_epi8( _mm_min_epu8( digit0, _mm_set1_epi8( 9 ) ), digit0 );
+    const __m128i high = _mm_cmplt_epi8( c, _mm_setzero_si128() );
+    const __m128i punct = _mm_or_si128(
+        _mm_or_si128( _mm_cmpeq_epi8( c, _mm_set1_epi8( ':' ) ), _mm_cmpeq_epi8( c, _mm_set1_epi8( '_' ) ) ),
+        _mm_or_si128( _mm_cmpeq_epi8( c, _mm_set1_epi8( '.' ) ), _mm_cmpeq_epi8( c, _mm_set1_epi8( '-' ) ) ) );
+    return _mm_or_si128( _mm_or_si128( letter, digit ), _mm_or_si128( high, punct ) );
+}
+
+static inline unsigned Mask16( __m128i m )
+{
+    return static_cast<unsigned>( _mm_movemask_epi8( m ) );
+}
+
+static const char* SkipWhiteSpaceSSE2( const char* p, int* curLineNumPtr )
+{
+    for( ;; p += 16 ) {
+        const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+        const unsigned stop = ~Mask16( WhiteSpace16( c ) ) & 0xffffu;
+        const unsigned lines = curLineNumPtr ? Mask16( _mm_cmpeq_epi8( c, _mm_set1_epi8( '\n' ) ) ) : 0;
+        if ( stop ) {
+            const int i = LowestBit( stop );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountBits( lines & ( ( 1u << i ) - 1 ) );
+            }
+            return p + i;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountBits( lines );
+        }
+    }
+}
+
+static const char* FindCharSSE2( const char* p, char ch, int* curLineNumPtr )
+{
+    const __m128i target = _mm_set1_epi8( ch );
+    for( ;; p += 16 ) {
+        const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+        const unsigned stop = Mask16( _mm_or_si128( _mm_cmpeq_epi8( c, target ), _mm_cmpeq_epi8( c, _mm_setzero_si128() ) ) );
+        const unsigned lines = Mask16( _mm_cmpeq_epi8( c, _mm_set1_epi8( '\n' ) ) );
+        if ( stop ) {
+            const int i = LowestBit( stop );
+            *curLineNumPtr += CountBits( lines & ( ( 1u << i ) - 1 ) );
+            return p + i;
+        }
+        *curLineNumPtr += CountBits( lines );
+    }
+}
+
+static const char* NameEndSSE2( const char* p )
+{
+    for( ;; p += 16 ) {
+        const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+        const unsigned stop = ~Mask16( NameChar16( c ) ) & 0xffffu;
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+}
+
+static const char* FindAnySSE2( const char* p, const char* end, const char* set )
+{
+    __m128i targets[NUM_ENTITIES];
+    for( int i=0; i<NUM_ENTITIES; ++i ) {
+        targets[i] = _mm_set1_epi8( set[i] );
+    }
+    for( ; end - p >= 16; p += 16 ) {
+        const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+        __m128i match = _mm_cmpeq_epi8( c, targets[0] );
+        for( int i=1; i<NUM_ENTITIES; ++i ) {
+            match = _mm_or_si128( match, _mm_cmpeq_epi8( c, targets[i] ) );
+        }
+        const unsigned stop = Mask16( match );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindAnyScalar( p, end, set );
+}
+
+#endif // TIXML_USE_SSE2
+
+#ifdef TIXML_USE_AVX2
+
+#define TIXML_AVX2 __attribute__((target("avx2")))
+
+TIXML_AVX2 static inline __m256i WhiteSpace32( __m256i c )
+{
+    const __m256i x = _mm256_sub_epi8( c, _mm256_set1_epi8( 0x09 ) );
+    const __m256i control = _mm256_cmpeq_epi8( _mm256_min_epu8( x, _mm256_set1_epi8( 4 ) ), x );
+    return _mm256_or_si256( control, _mm256_cmpeq_epi8( c, _mm256_set1_epi8( ' ' ) ) );
+}
+
+TIXML_AVX2 static inline __m256i NameChar32( __m256i c )
+{
+    const __m256i lower = _mm256_sub_epi8( _mm256_or_si256( c, _mm256_set1_epi8( 0x20 ) ), _mm256_set1_epi8( 'a' ) );
+    const __m256i letter = _mm256_cmpeq_epi8( _mm256_min_epu8( lower, _mm256_set1_epi8( 25 ) ), lower );
+    const __m256i digit0 = _mm256_sub_epi8( c, _mm256_set1_epi8( '0' ) );
+    const __m256i digit = _mm256_cmpeq_epi8( _mm256_min_epu8( digit0, _mm256_set1_epi8( 9 ) ), digit0 );
+    const __m256i high = _mm256_cmpgt_epi8( _mm256_setzero_si256(), c );
+    const __m256i punct = _mm256_or_si256(
+        _mm256_or_si256( _mm256_cmpeq_epi8( c, _mm256_set1_epi8( ':' ) ), _mm256_cmpeq_epi8( c, _mm256_set1_epi8( '_' ) ) ),
+        _mm256_or_si256( _mm256_cmpeq_epi8( c, _mm256_set1_epi8( '.' ) ), _mm256_cmpeq_epi8( c, _mm256_set1_epi8( '-' ) ) ) );
+    return _mm256_or_si256( _mm256_or_si256( letter, digit ), _mm256_or_si256( high, punct ) );
+}
+
+TIXML_AVX2 static inline unsigned Mask32( __m256i m )
+{
+    return static_cast<unsigned>( _mm256_movemask_epi8( m ) );
+}
+
+TIXML_AVX2 static const char* SkipWhiteSpaceAVX2( const char* p, int* curLineNumPtr )
+{
+    for( ;; p += 32 ) {
+        const __m256i c = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+        const unsigned stop = ~Mask32( WhiteSpace32( c ) );
+        const unsigned lines = curLineNumPtr ? Mask32( _mm256_cmpeq_epi8( c, _mm256_set1_epi8( '\n' ) ) ) : 0;
+        if ( stop ) {
+            const int i = LowestBit( stop );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountBits( lines & ( ( 1u << i ) - 1 ) );
+            }
+            return p + i;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountBits( lines );
+        }
+    }
+}
+
+TIXML_AVX2 static const char* FindCharAVX2( const char* p, char ch, int* curLineNumPtr )
+{
+    const __m256i target = _mm256_set1_epi8( ch );
+    for( ;; p += 32 ) {
+        const __m256i c = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+        const unsigned stop = Mask32( _mm256_or_si256( _mm256_cmpeq_epi8( c, target ), _mm256_cmpeq_epi8( c, _mm256_setzero_si256() ) ) );
+        const unsigned lines = Mask32( _mm256_cmpeq_epi8( c, _mm256_set1_epi8( '\n' ) ) );
+        if ( stop ) {
+            const int i = LowestBit( stop );
+            *curLineNumPtr += CountBits( lines & ( ( 1u << i ) - 1 ) );
+            return p + i;
+        }
+        *curLineNumPtr += CountBits( lines );
+    }
+}
+
+TIXML_AVX2 static const char* NameEndAVX2( const char* p )
+{
+    for( ;; p += 32 ) {
+        const __m256i c = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+        const unsigned stop = ~Mask32( NameChar32( c ) );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+}
+
+TIXML_AVX2 static const char* FindAnyAVX2( const char* p, const char* end, const char* set )
+{
+    __m256i targets[NUM_ENTITIES];
+    for( int i=0; i<NUM_ENTITIES; ++i ) {
+        targets[i] = _mm256_set1_epi8( set[i] );
+    }
+    for( ; end - p >= 32; p += 32 ) {
+        const __m256i c = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(p) );
+        __m256i match = _mm256_cmpeq_epi8( c, targets[0] );
+        for( int i=1; i<NUM_ENTITIES; ++i ) {
+            match = _mm256_or_si256( match, _mm256_cmpeq_epi8( c, targets[i] ) );
+        }
+        const unsigned stop = Mask32( match );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindAnyScalar( p, end, set );
+}
+
+#endif // TIXML_USE_AVX2
+
+static ScanFunctions SelectScanFunctions()
+{
+#ifdef TIXML_USE_AVX2
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        const ScanFunctions avx2 = { SkipWhiteSpaceAVX2, FindCharAVX2, NameEndAVX2, FindAnyAVX2 };
+        return avx2;
+    }
+#endif
+#ifdef TIXML_USE_SSE2
+    const ScanFunctions sse2 = { SkipWhiteSpaceSSE2, FindCharSSE2, NameEndSSE2, FindAnySSE2 };
+    return sse2;
+#else
+    // Without SSE2 the plain loops are the only version
+    const ScanFunctions scalar = { SkipWhiteSpaceScalar, FindCharScalar, NameEndScalar, FindAnyScalar };
+    return scalar;
+#endif
+}
+
+static const ScanFunctions& Scan()
+{
+    static const ScanFunctions functions = SelectScanFunctions();
+    return functions;
+}
+
+
+// XMLUtil::SkipWhiteSpace for the parsers' own, padded, buffers. Most calls find no
+// white space at all; runs are scanned a block at a time
+static char* SkipBufferWhiteSpace( char* p, int* curLineNumPtr )
+{
+    TIXMLASSERT( p );
+    if ( XMLUtil::IsWhiteSpace( *p ) ) {
+        p = const_cast<char*>( Scan().skipWhiteSpace( p, curLineNumPtr ) );
+    }
+    return p;
+}
+
+
 StrPair::~StrPair()
 {
     Reset();
@@ -214,18 +573,18 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     const char  endChar = *endTag;
     size_t length = strlen( endTag );
 
-    // Inner loop of text parsing.
-    while ( *p ) {
-        if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+    // Inner loop of text parsing: jump from one candidate for the end tag to the next.
+    for( ;; ) {
+        p = const_cast<char*>( Scan().findChar( p, endChar, curLineNumPtr ) );
+        if ( !*p ) {
+            return 0;
+        }
+        if ( strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
             return p + length;
-        } else if (*p == '\n') {
-            ++(*curLineNumPtr);
         }
         ++p;
-        TIXMLASSERT( p );
     }
-    return 0;
 }
 
 
@@ -239,10 +598,7 @@ char* StrPair::ParseName( char* p )
     }
 
     char* const start = p;
-    ++p;
-    while ( *p && XMLUtil::IsNameChar( (unsigned char) *p ) ) {
-        ++p;
-    }
+    p = const_cast<char*>( Scan().nameEnd( p + 1 ) );
 
     Set( start, p, 0 );
     return p;
@@ -281,7 +637,7 @@ void StrPair::CollapseWhitespace()
 const char* StrPair::GetStr()
 {
     TIXMLASSERT( _start );
-    TIXMLASSERT( _end );
+    TIXMLASSERT( _end || !( _flags & NEEDS_FLUSH ) );	// interned strings have no end
     if ( _flags & NEEDS_FLUSH ) {
         *_end = 0;
         _flags ^= NEEDS_FLUSH;
@@ -381,6 +737,157 @@ const char* StrPair::GetStr()
 
 
 
+// --------- NameTable ----------- //
+
+NameTable::NameTable() :
+    _entries( 0 ),
+    _capacity( 0 ),
+    _size( 0 ),
+    _blockPtrs(),
+    _longNames(),
+    _block( -1 ),
+    _blockUsed( 0 )
+{
+}
+
+
+NameTable::~NameTable()
+{
+    Clear();
+}
+
+
+void NameTable::Reset()
+{
+    for( int i = 0; i < _capacity; ++i ) {
+        _entries[i].name = 0;
+    }
+    _size = 0;
+    while( !_longNames.Empty() ) {
+        delete [] _longNames.Pop();
+    }
+    _block = -1;
+    _blockUsed = 0;
+}
+
+
+void NameTable::Clear()
+{
+    Reset();
+    delete [] _entries;
+    _entries = 0;
+    _capacity = 0;
+    while( !_blockPtrs.Empty() ) {
+        delete [] _blockPtrs.Pop();
+    }
+}
+
+
+unsigned NameTable::Hash( const char* name, size_t* length )
+{
+    // FNV-1a
+    unsigned hash = 2166136261u;
+    const char* p = name;
+    for( ; *p; ++p ) {
+        hash = ( hash ^ static_cast<unsigned char>(*p) ) * 16777619u;
+    }
+    *length = static_cast<size_t>( p - name );
+    return hash;
+}
+
+
+NameTable::Entry* NameTable::Lookup( const char* name, size_t length, unsigned hash ) const
+{
+    TIXMLASSERT( _capacity > 0 );
+    const unsigned mask = static_cast<unsigned>( _capacity - 1 );
+    for( unsigned i = hash & mask; ; i = ( i + 1 ) & mask ) {
+        Entry* entry = _entries + i;
+        if ( !entry->name
+             || ( entry->hash == hash && entry->length == length && memcmp( entry->name, name, length ) == 0 ) ) {
+            return entry;
+        }
+    }
+}
+
+
+const char* NameTable::Find( const char* name ) const
+{
+    TIXMLASSERT( name );
+    if ( _size == 0 ) {
+        return 0;
+    }
+    size_t length = 0;
+    const unsigned hash = Hash( name, &length );
+    return Lookup( name, length, hash )->name;
+}
+
+
+const char* NameTable::Intern( const char* name )
+{
+    TIXMLASSERT( name );
+    // Keep the table at most half full
+    if ( 2 * ( _size + 1 ) > _capacity ) {
+        Grow();
+    }
+    size_t length = 0;
+    const unsigned hash = Hash( name, &length );
+    Entry* entry = Lookup( name, length, hash );
+    if ( !entry->name ) {
+        entry->name = Store( name, length );
+        entry->length = length;
+        entry->hash = hash;
+        ++_size;
+    }
+    return entry->name;
+}
+
+
+char* NameTable::Store( const char* name, size_t length )
+{
+    // Names are packed into blocks; one that would take a good part of
+    // a block gets a block of its own.
+    const size_t size = length + 1;
+    char* stored = 0;
+    if ( size > BLOCK_SIZE / 4 ) {
+        stored = new char[size];
+        _longNames.Push( stored );
+    }
+    else {
+        if ( _block < 0 || _blockUsed + size > BLOCK_SIZE ) {
+            // Move on to the next block, which may be left from before a Reset()
+            ++_block;
+            if ( _block == _blockPtrs.Size() ) {
+                _blockPtrs.Push( new char[BLOCK_SIZE] );
+            }
+            _blockUsed = 0;
+        }
+        stored = _blockPtrs[_block] + _blockUsed;
+        _blockUsed += size;
+    }
+    memcpy( stored, name, length );
+    stored[length] = 0;
+    return stored;
+}
+
+
+void NameTable::Grow()
+{
+    Entry* const old = _entries;
+    const int oldCapacity = _capacity;
+    _capacity = _capacity ? 2 * _capacity : 32;
+    _entries = new Entry[_capacity];
+    for( int i = 0; i < _capacity; ++i ) {
+        _entries[i].name = 0;
+    }
+    for( int i = 0; i < oldCapacity; ++i ) {
+        if ( old[i].name ) {
+            *Lookup( old[i].name, old[i].length, old[i].hash ) = old[i];
+        }
+    }
+    delete [] old;
+}
+
+
 // --------- XMLUtil ----------- //
 
 const char* XMLUtil::writeBoolTrue  = "true";
@@ -563,15 +1070,39 @@ const char* XMLUtil::GetCharacterRef( const char* p, char* value, int* length )
 }
 
 
+#if defined(TIXML_USE_CHARCONV)
+/*
+	Numbers are written with std::to_chars: locale independent, and for
+	floating point the shortest text that reads back to the same value,
+	so 3.14159 stays "3.14159" rather than becoming "3.1415899999999999".
+*/
+template<typename T>
+static void ToCharsStr( T v, char* buffer, int bufferSize )
+{
+    TIXMLASSERT( bufferSize > 0 );
+    const std::to_chars_result result = std::to_chars( buffer, buffer + bufferSize - 1, v );
+    *( result.ec == std::errc() ? result.ptr : buffer ) = 0;
+}
+#endif
+
+
 void XMLUtil::ToStr( int v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
     TIXML_SNPRINTF( buffer, bufferSize, "%d", v );
+#endif
 }
 
 
 void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
     TIXML_SNPRINTF( buffer, bufferSize, "%u", v );
+#endif
 }
 
 
@@ -586,56 +1117,127 @@ void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
 */
 void XMLUtil::ToStr( float v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
     TIXML_SNPRINTF( buffer, bufferSize, "%.8g", v );
+#endif
 }
 
 
 void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
     TIXML_SNPRINTF( buffer, bufferSize, "%.17g", v );
+#endif
 }
 
 
 void XMLUtil::ToStr( int64_t v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
 	// horrible syntax trick to make the compiler happy about %lld
 	TIXML_SNPRINTF(buffer, bufferSize, "%lld", static_cast<long long>(v));
+#endif
 }
 
 void XMLUtil::ToStr( uint64_t v, char* buffer, int bufferSize )
 {
+#if defined(TIXML_USE_CHARCONV)
+    ToCharsStr( v, buffer, bufferSize );
+#else
     // horrible syntax trick to make the compiler happy about %llu
     TIXML_SNPRINTF(buffer, bufferSize, "%llu", (long long)v);
+#endif
 }
 
-bool XMLUtil::ToInt(const char* str, int* value)
+#if defined(TIXML_USE_CHARCONV)
+/*
+	Numbers are read with std::from_chars: locale independent and free of
+	sscanf's format string handling. As with sscanf, leading white space and
+	a '+' sign are accepted, a "0x" prefix selects hexadecimal, and anything
+	after the number is ignored.
+*/
+static const char* SkipToDigits( const char* str, bool hex )
 {
-    if (IsPrefixHex(str)) {
-        unsigned v;
-        if (TIXML_SSCANF(str, "%x", &v) == 1) {
-            *value = static_cast<int>(v);
-            return true;
-        }
+    const char* p = XMLUtil::SkipWhiteSpace( str, 0 );
+    if ( hex ) {
+        return p + 2;	// the caller checked IsPrefixHex()
     }
-    else {
-        if (TIXML_SSCANF(str, "%d", value) == 1) {
-            return true;
-        }
+    if ( *p == '+' && *(p+1) != '-' ) {
+        ++p;
     }
-    return false;
+    return p;
 }
 
-bool XMLUtil::ToUnsigned(const char* str, unsigned* value)
+template<typename T>
+static bool FromCharsInt( const char* str, T* value, bool hex )
 {
-    if (TIXML_SSCANF(str, IsPrefixHex(str) ? "%x" : "%u", value) == 1) {
-        return true;
-    }
-    return false;
+    const char* p = SkipToDigits( str, hex );
+    const std::from_chars_result result = std::from_chars( p, p + strlen( p ), *value, hex ? 16 : 10 );
+    return result.ec == std::errc();
 }
 
-bool XMLUtil::ToBool( const char* str, bool* value )
+template<typename T>
+static bool FromCharsFloat( const char* str, T* value )
 {
-    int ival = 0;
+    const bool hex = XMLUtil::IsPrefixHex( str );
+    const char* p = SkipToDigits( str, hex );
+    const std::from_chars_result result = std::from_chars( p, p + strlen( p ), *value,
+                                                           hex ? std::chars_format::hex : std::chars_format::general );
+    return result.ec == std::errc();
+}
+#endif
+
+
+bool XMLUtil::ToInt(const char* str, int* value)
+{
+#if defined(TIXML_USE_CHARCONV)
+    if (IsPrefixHex(str)) {
+        unsigned v;
+        if (FromCharsInt(str, &v, true)) {
+            *value = static_cast<int>(v);
+            return true;
+        }
+        return false;
+    }
+    return FromCharsInt(str, value, false);
+#else
+    if (IsPrefixHex(str)) {
+        unsigned v;
+        if (TIXML_SSCANF(str, "%x", &v) == 1) {
+            *value = static_cast<int>(v);
+            return true;
+        }
+    }
+    else {
+        if (TIXML_SSCANF(str, "%d", value) == 1) {
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+bool XMLUtil::ToUnsigned(const char* str, unsigned* value)
+{
+#if defined(TIXML_USE_CHARCONV)
+    return FromCharsInt(str, value, IsPrefixHex(str));
+#else
+    if (TIXML_SSCANF(str, IsPrefixHex(str) ? "%x" : "%u", value) == 1) {
+        return true;
+    }
+    return false;
+#endif
+}
+
+bool XMLUtil::ToBool( const char* str, bool* value )
+{
+    int ival = 0;
     if ( ToInt( str, &ival )) {
         *value = (ival==0) ? false : true;
         return true;
@@ -661,24 +1263,43 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
+#if defined(TIXML_USE_CHARCONV)
+    return FromCharsFloat( str, value );
+#else
     if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
         return true;
     }
     return false;
+#endif
 }
 
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
+#if defined(TIXML_USE_CHARCONV)
+    return FromCharsFloat( str, value );
+#else
     if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
         return true;
     }
     return false;
+#endif
 }
 
 
 bool XMLUtil::ToInt64(const char* str, int64_t* value)
 {
+#if defined(TIXML_USE_CHARCONV)
+    if (IsPrefixHex(str)) {
+        uint64_t v = 0;
+        if (FromCharsInt(str, &v, true)) {
+            *value = static_cast<int64_t>(v);
+            return true;
+        }
+        return false;
+    }
+    return FromCharsInt(str, value, false);
+#else
     if (IsPrefixHex(str)) {
         unsigned long long v = 0;	// horrible syntax trick to make the compiler happy about %llx
         if (TIXML_SSCANF(str, "%llx", &v) == 1) {
@@ -694,16 +1315,21 @@ bool XMLUtil::ToInt64(const char* str, int64_t* value)
         }
     }
 	return false;
+#endif
 }
 
 
 bool XMLUtil::ToUnsigned64(const char* str, uint64_t* value) {
+#if defined(TIXML_USE_CHARCONV)
+    return FromCharsInt(str, value, IsPrefixHex(str));
+#else
     unsigned long long v = 0;	// horrible syntax trick to make the compiler happy about %llu
     if(TIXML_SSCANF(str, IsPrefixHex(str) ? "%llx" : "%llu", &v) == 1) {
         *value = (uint64_t)v;
         return true;
     }
     return false;
+#endif
 }
 
 
@@ -713,7 +1339,7 @@ char* XMLDocument::Identify( char* p, XMLNode** node, bool first )
     TIXMLASSERT( p );
     char* const start = p;
     int const startLine = _parseCurLineNum;
-    p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+    p = SkipBufferWhiteSpace( p, &_parseCurLineNum );
     if( !*p ) {
         *node = 0;
         TIXMLASSERT( p );
@@ -862,7 +1488,11 @@ const char* XMLNode::Value() const
 
 void XMLNode::SetValue( const char* str, bool staticMem )
 {
-    if ( staticMem ) {
+    if ( ToElement() ) {
+        // Element names are compared by pointer
+        _value.SetInternedStr( _document->InternName( str ) );
+    }
+    else if ( staticMem ) {
         _value.SetInternedStr( str );
     }
     else {
@@ -1031,6 +1661,13 @@ XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
 
 const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 {
+    if ( name ) {
+        // A name no element of the document was given cannot match
+        name = _document->FindName( name );
+        if ( !name ) {
+            return 0;
+        }
+    }
     for( const XMLNode* node = _firstChild; node; node = node->_next ) {
         const XMLElement* element = node->ToElementWithName( name );
         if ( element ) {
@@ -1043,6 +1680,12 @@ const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 
 const XMLElement* XMLNode::LastChildElement( const char* name ) const
 {
+    if ( name ) {
+        name = _document->FindName( name );
+        if ( !name ) {
+            return 0;
+        }
+    }
     for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
         const XMLElement* element = node->ToElementWithName( name );
         if ( element ) {
@@ -1055,6 +1698,12 @@ const XMLElement* XMLNode::LastChildElement( const char* name ) const
 
 const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 {
+    if ( name ) {
+        name = _document->FindName( name );
+        if ( !name ) {
+            return 0;
+        }
+    }
     for( const XMLNode* node = _next; node; node = node->_next ) {
         const XMLElement* element = node->ToElementWithName( name );
         if ( element ) {
@@ -1067,6 +1716,12 @@ const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 
 const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
 {
+    if ( name ) {
+        name = _document->FindName( name );
+        if ( !name ) {
+            return 0;
+        }
+    }
     for( const XMLNode* node = _prev; node; node = node->_prev ) {
         const XMLElement* element = node->ToElementWithName( name );
         if ( element ) {
@@ -1231,7 +1886,7 @@ const XMLElement* XMLNode::ToElementWithName( const char* name ) const
     if ( name == 0 ) {
         return element;
     }
-    if ( XMLUtil::StringEqual( element->Name(), name ) ) {
+    if ( element->Name() == name ) {
        return element;
     }
     return 0;
@@ -1456,13 +2111,13 @@ char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr
     }
 
     // Skip white space before =
-    p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+    p = SkipBufferWhiteSpace( p, curLineNumPtr );
     if ( *p != '=' ) {
         return 0;
     }
 
     ++p;	// move up to opening quote
-    p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+    p = SkipBufferWhiteSpace( p, curLineNumPtr );
     if ( *p != '\"' && *p != '\'' ) {
         return 0;
     }
@@ -1477,7 +2132,7 @@ char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr
 
 void XMLAttribute::SetName( const char* n )
 {
-    _name.SetStr( n );
+    _name.SetInternedStr( n );
 }
 
 
@@ -1623,8 +2278,12 @@ XMLElement::~XMLElement()
 
 const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 {
+    name = _document->FindName( name );
+    if ( !name ) {
+        return 0;
+    }
     for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
-        if ( XMLUtil::StringEqual( a->Name(), name ) ) {
+        if ( a->Name() == name ) {
             return a;
         }
     }
@@ -1921,10 +2580,11 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
     XMLAttribute* last = 0;
     XMLAttribute* attrib = 0;
+    name = _document->InternName( name );
     for( attrib = _rootAttribute;
             attrib;
             last = attrib, attrib = attrib->_next ) {
-        if ( XMLUtil::StringEqual( attrib->Name(), name ) ) {
+        if ( attrib->Name() == name ) {
             break;
         }
     }
@@ -1947,9 +2607,13 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 
 void XMLElement::DeleteAttribute( const char* name )
 {
+    name = _document->FindName( name );
+    if ( !name ) {
+        return;
+    }
     XMLAttribute* prev = 0;
     for( XMLAttribute* a=_rootAttribute; a; a=a->_next ) {
-        if ( XMLUtil::StringEqual( name, a->Name() ) ) {
+        if ( a->Name() == name ) {
             if ( prev ) {
                 prev->_next = a->_next;
             }
@@ -1970,7 +2634,7 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
 
     // Read the attributes.
     while( p ) {
-        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+        p = SkipBufferWhiteSpace( p, curLineNumPtr );
         if ( !(*p) ) {
             _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
             return 0;
@@ -1985,7 +2649,15 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
             const int attrLineNum = attrib->_parseLineNum;
 
             p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            bool duplicate = false;
+            if ( p ) {
+                // The '=' after the name has been read, so the name can be terminated in place
+                attrib->SetName( _document->InternName( attrib->Name() ) );
+                for( const XMLAttribute* a = _rootAttribute; a && !duplicate; a = a->_next ) {
+                    duplicate = a->Name() == attrib->Name();
+                }
+            }
+            if ( !p || duplicate ) {
                 DeleteAttribute( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
@@ -2083,7 +2755,7 @@ XMLUnknown* XMLElement::InsertNewUnknown(const char* text)
 char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
 {
     // Read the element name.
-    p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+    p = SkipBufferWhiteSpace( p, curLineNumPtr );
 
     // The closing element is the </element> form. It is
     // parsed just like a regular element then deleted from
@@ -2099,6 +2771,11 @@ char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
     }
 
     p = ParseAttributes( p, curLineNumPtr );
+    if ( p ) {
+        // The name is followed by white space, '/' or '>', all read by now,
+        // so it can be terminated in place
+        _value.SetInternedStr( _document->InternName( _value.GetStr() ) );
+    }
     if ( !p || !*p || _closingType != OPEN ) {
         return p;
     }
@@ -2114,7 +2791,7 @@ XMLNode* XMLElement::ShallowClone( XMLDocument* doc ) const
     if ( !doc ) {
         doc = _document;
     }
-    XMLElement* element = doc->NewElement( Value() );					// fixme: this will always allocate memory. Intern?
+    XMLElement* element = doc->NewElement( Value() );
     for( const XMLAttribute* a=FirstAttribute(); a; a=a->Next() ) {
         element->SetAttribute( a->Name(), a->Value() );					// fixme: this will always allocate memory. Intern?
     }
@@ -2192,11 +2869,14 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
+    _normalizeOnParse( false ),
     _errorID(XML_SUCCESS),
     _whitespaceMode( whitespaceMode ),
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _charBufferSize( 0 ),
+    _mappedSize( 0 ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
@@ -2230,19 +2910,30 @@ void XMLDocument::MarkInUse(const XMLNode* const node)
 }
 
 void XMLDocument::Clear()
+{
+    Reset();
+    _names.Clear();
+    FreeCharBuffer();
+}
+
+
+void XMLDocument::Reset()
 {
     DeleteChildren();
 	while( _unlinked.Size()) {
 		DeleteNode(_unlinked[0]);	// Will remove from _unlinked as part of delete.
 	}
+    _names.Reset();
 
 #ifdef TINYXML2_DEBUG
     const bool hadError = Error();
 #endif
     ClearError();
 
-    delete [] _charBuffer;
-    _charBuffer = 0;
+    // A buffer from new[] can take the next document; a mapping cannot
+    if ( _mappedSize ) {
+        FreeCharBuffer();
+    }
 	_parsingDepth = 0;
 
 #if 0
@@ -2357,7 +3048,7 @@ XMLError XMLDocument::LoadFile( const char* filename )
         return _errorID;
     }
 
-    Clear();
+    Reset();
     FILE* fp = callfopen( filename, "rb" );
     if ( !fp ) {
         SetError( XML_ERROR_FILE_NOT_FOUND, 0, "filename=%s", filename );
@@ -2368,9 +3059,39 @@ XMLError XMLDocument::LoadFile( const char* filename )
     return _errorID;
 }
 
+
+void XMLDocument::ReserveCharBuffer( size_t size )
+{
+    TIXMLASSERT( _mappedSize == 0 );
+    if ( size > _charBufferSize ) {
+        FreeCharBuffer();
+        _charBuffer = new char[size + SCAN_PADDING];
+        _charBufferSize = size;
+    }
+    memset( _charBuffer + size, 0, SCAN_PADDING );
+}
+
+
+void XMLDocument::FreeCharBuffer()
+{
+#ifdef TIXML_USE_MMAP
+    if ( _mappedSize ) {
+        munmap( _charBuffer, _mappedSize );
+        _mappedSize = 0;
+    }
+    else
+#endif
+    {
+        delete [] _charBuffer;
+    }
+    _charBuffer = 0;
+    _charBufferSize = 0;
+}
+
+
 XMLError XMLDocument::LoadFile( FILE* fp )
 {
-    Clear();
+    Reset();
 
     TIXML_FSEEK( fp, 0, SEEK_SET );
     if ( fgetc( fp ) == EOF && ferror( fp ) != 0 ) {
@@ -2407,8 +3128,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
     }
 
     const size_t size = static_cast<size_t>(filelength);
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[size+1];
+    ReserveCharBuffer( size+1 );
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2422,6 +3142,67 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 }
 
 
+XMLError XMLDocument::LoadMappedFile( const char* filename )
+{
+#ifdef TIXML_USE_MMAP
+    if ( !filename ) {
+        TIXMLASSERT( false );
+        SetError( XML_ERROR_FILE_COULD_NOT_BE_OPENED, 0, "filename=<null>" );
+        return _errorID;
+    }
+
+    Reset();
+    FreeCharBuffer();
+    const int fd = open( filename, O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, 0, "filename=%s", filename );
+        return _errorID;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || static_cast<unsigned long long>(st.st_size) >= static_cast<unsigned long long>(static_cast<size_t>(-1)) ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    if ( st.st_size == 0 ) {
+        close( fd );
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+
+    // The parser needs a null terminator and SCAN_PADDING bytes after the text. Reserve
+    // zero-filled anonymous pages for them past the end of the file and map the file over
+    // the front; the tail of the file's last page reads as zeros too.
+    const size_t size = static_cast<size_t>(st.st_size);
+    const size_t page = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+    const size_t length = ( ( size + SCAN_PADDING ) / page + 1 ) * page;
+    void* base = mmap( 0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( base == MAP_FAILED ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    if ( mmap( base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0 ) == MAP_FAILED ) {
+        munmap( base, length );
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    close( fd );
+    madvise( base, size, MADV_SEQUENTIAL );
+
+    TIXMLASSERT( _charBuffer == 0 );
+    _charBuffer = static_cast<char*>( base );
+    _mappedSize = length;
+
+    Parse();
+    return _errorID;
+#else
+    return LoadFile( filename );
+#endif
+}
+
+
 XMLError XMLDocument::SaveFile( const char* filename, bool compact )
 {
     if ( !filename ) {
@@ -2447,6 +3228,8 @@ XMLError XMLDocument::SaveFile( FILE* fp, bool compact )
     // for *this* call.
     ClearError();
     XMLPrinter stream( fp, compact );
+    // The printer is gone, and so flushed, before the caller gets the FILE* back
+    stream.SetBuffered( true );
     Print( &stream );
     return _errorID;
 }
@@ -2454,7 +3237,7 @@ XMLError XMLDocument::SaveFile( FILE* fp, bool compact )
 
 XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
 {
-    Clear();
+    Reset();
 
     if ( nBytes == 0 || !xml || !*xml ) {
         SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
@@ -2463,8 +3246,7 @@ XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
     if ( nBytes == static_cast<size_t>(-1) ) {
         nBytes = strlen( xml );
     }
-    TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[ nBytes+1 ];
+    ReserveCharBuffer( nBytes+1 );
     memcpy( _charBuffer, xml, nBytes );
     _charBuffer[nBytes] = 0;
 
@@ -2557,18 +3339,50 @@ const char* XMLDocument::ErrorName() const
 
 void XMLDocument::Parse()
 {
-    TIXMLASSERT( NoChildren() ); // Clear() must have been called previously
+    TIXMLASSERT( NoChildren() ); // Reset() must have been called previously
     TIXMLASSERT( _charBuffer );
     _parseCurLineNum = 1;
     _parseLineNum = 1;
     char* p = _charBuffer;
-    p = XMLUtil::SkipWhiteSpace( p, &_parseCurLineNum );
+    p = SkipBufferWhiteSpace( p, &_parseCurLineNum );
     p = const_cast<char*>( XMLUtil::ReadBOM( p, &_writeBOM ) );
     if ( !*p ) {
         SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
         return;
     }
     ParseDeep(p, 0, &_parseCurLineNum );
+    if ( _normalizeOnParse && !Error() ) {
+        NormalizeStrings();
+    }
+}
+
+void XMLDocument::NormalizeStrings()
+{
+    // Reading every string once decodes it, and later reads only return it.
+    // Walk the tree in document order without recursion.
+    XMLNode* node = FirstChild();
+    while ( node ) {
+        node->Value();
+        if ( const XMLElement* element = node->ToElement() ) {
+            for( const XMLAttribute* a = element->FirstAttribute(); a; a = a->Next() ) {
+                a->Name();
+                a->Value();
+            }
+        }
+        if ( node->FirstChild() ) {
+            node = node->FirstChild();
+            continue;
+        }
+        while ( node && !node->NextSibling() ) {
+            node = node->Parent();
+            if ( node == this ) {
+                node = 0;
+            }
+        }
+        if ( node ) {
+            node = node->NextSibling();
+        }
+    }
 }
 
 void XMLDocument::PushDepth()
@@ -2590,6 +3404,10 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
     _stack(),
     _firstElement( true ),
     _fp( file ),
+    _fileBuffer( 0 ),
+    _fileBufferUsed( 0 ),
+    _directWrite( false ),
+    _writeError( false ),
     _depth( depth ),
     _textDepth( -1 ),
     _processEntities( true ),
@@ -2613,20 +3431,105 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth ) :
 }
 
 
+XMLPrinter::~XMLPrinter()
+{
+    Flush();
+    delete [] _fileBuffer;
+}
+
+
+void XMLPrinter::SetBuffered( bool buffered )
+{
+    if ( !_fp ) {
+        return;
+    }
+    if ( buffered && !_fileBuffer ) {
+        _fileBuffer = new char[FILE_BUFFER_SIZE];
+    }
+    else if ( !buffered && _fileBuffer ) {
+        Flush();
+        delete [] _fileBuffer;
+        _fileBuffer = 0;
+    }
+}
+
+
+void XMLPrinter::Flush()
+{
+    if ( _fp && _fileBufferUsed ) {
+        WriteFile( _fileBuffer, _fileBufferUsed );
+        _fileBufferUsed = 0;
+    }
+}
+
+
+void XMLPrinter::WriteFile( const char* data, size_t size )
+{
+#if !defined(_WIN32)
+    if ( _directWrite ) {
+        // Whatever stdio still holds for the file goes first
+        if ( fflush( _fp ) != 0 ) {
+            _writeError = true;
+            return;
+        }
+        const int fd = fileno( _fp );
+        while ( size > 0 ) {
+            const ssize_t written = ::write( fd, data, size );
+            if ( written < 0 ) {
+                if ( errno == EINTR ) {
+                    continue;
+                }
+                _writeError = true;
+                return;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return;
+    }
+#endif
+    if ( fwrite( data, 1, size, _fp ) != size ) {
+        _writeError = true;
+    }
+}
+
+
 void XMLPrinter::Print( const char* format, ... )
 {
     va_list     va;
     va_start( va, format );
 
+    if ( _fp && !_fileBuffer ) {
+        if ( vfprintf( _fp, format, va ) < 0 ) {
+            _writeError = true;
+        }
+        va_end( va );
+        return;
+    }
+
+    const int len = TIXML_VSCPRINTF( format, va );
+    // Close out and re-start the va-args
+    va_end( va );
+    TIXMLASSERT( len >= 0 );
+    va_start( va, format );
+
     if ( _fp ) {
-        vfprintf( _fp, format, va );
+        const size_t size = static_cast<size_t>(len) + 1;	// room for the terminator vsnprintf writes
+        if ( size > FILE_BUFFER_SIZE - _fileBufferUsed ) {
+            Flush();
+        }
+        if ( size <= FILE_BUFFER_SIZE ) {
+            TIXML_VSNPRINTF( _fileBuffer + _fileBufferUsed, size, format, va );
+            _fileBufferUsed += static_cast<size_t>(len);
+        }
+        else {
+            char* p = new char[size];
+            TIXML_VSNPRINTF( p, size, format, va );
+            WriteFile( p, static_cast<size_t>(len) );
+            delete [] p;
+        }
     }
     else {
-        const int len = TIXML_VSCPRINTF( format, va );
-        // Close out and re-start the va-args
-        va_end( va );
-        TIXMLASSERT( len >= 0 );
-        va_start( va, format );
         TIXMLASSERT( _buffer.Size() > 0 && _buffer[_buffer.Size() - 1] == 0 );
         char* p = _buffer.PushArr( len ) - 1;	// back up over the null terminator.
 		TIXML_VSNPRINTF( p, len+1, format, va );
@@ -2637,8 +3540,22 @@ void XMLPrinter::Print( const char* format, ... )
 
 void XMLPrinter::Write( const char* data, size_t size )
 {
-    if ( _fp ) {
-        fwrite ( data , sizeof(char), size, _fp);
+    if ( _fp && !_fileBuffer ) {
+        if ( fwrite( data, sizeof(char), size, _fp ) != size ) {
+            _writeError = true;
+        }
+    }
+    else if ( _fp ) {
+        if ( size > FILE_BUFFER_SIZE - _fileBufferUsed ) {
+            Flush();
+            if ( size >= FILE_BUFFER_SIZE ) {
+                // too big to be worth copying
+                WriteFile( data, size );
+                return;
+            }
+        }
+        memcpy( _fileBuffer + _fileBufferUsed, data, size );
+        _fileBufferUsed += size;
     }
     else {
         char* p = _buffer.PushArr( static_cast<int>(size) ) - 1;   // back up over the null terminator.
@@ -2650,8 +3567,16 @@ void XMLPrinter::Write( const char* data, size_t size )
 
 void XMLPrinter::Putc( char ch )
 {
-    if ( _fp ) {
-        fputc ( ch, _fp);
+    if ( _fp && !_fileBuffer ) {
+        if ( fputc( ch, _fp ) == EOF ) {
+            _writeError = true;
+        }
+    }
+    else if ( _fp ) {
+        if ( _fileBufferUsed == FILE_BUFFER_SIZE ) {
+            Flush();
+        }
+        _fileBuffer[_fileBufferUsed++] = ch;
     }
     else {
         char* p = _buffer.PushArr( sizeof(char) ) - 1;   // back up over the null terminator.
@@ -2672,50 +3597,48 @@ void XMLPrinter::PrintSpace( int depth )
 void XMLPrinter::PrintString( const char* p, bool restricted )
 {
     // Look for runs of bytes between entities to print.
-    const char* q = p;
-
     if ( _processEntities ) {
         const bool* flag = restricted ? _restrictedEntityFlag : _entityFlag;
-        while ( *q ) {
+        // The characters to escape, for the block scan; the rest of the set stays 0
+        char escaped[NUM_ENTITIES] = { 0 };
+        int numEscaped = 0;
+        for( int i=0; i<NUM_ENTITIES; ++i ) {
+            if ( flag[static_cast<unsigned char>(entities[i].value)] ) {
+                escaped[numEscaped++] = entities[i].value;
+            }
+        }
+        const ScanFunctions& scan = Scan();
+        const char* const end = p + strlen( p );
+        for( ;; ) {
+            const char* q = scan.findAny( p, end, escaped );
             TIXMLASSERT( p <= q );
-            // Remember, char is sometimes signed. (How many times has that bitten me?)
-            if ( *q > 0 && *q < ENTITY_RANGE ) {
-                // Check for entities. If one is found, flush
-                // the stream up until the entity, write the
-                // entity, and keep looking.
-                if ( flag[static_cast<unsigned char>(*q)] ) {
-                    while ( p < q ) {
-                        const size_t delta = q - p;
-                        const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
-                        Write( p, toPrint );
-                        p += toPrint;
-                    }
-                    bool entityPatternPrinted = false;
-                    for( int i=0; i<NUM_ENTITIES; ++i ) {
-                        if ( entities[i].value == *q ) {
-                            Putc( '&' );
-                            Write( entities[i].pattern, entities[i].length );
-                            Putc( ';' );
-                            entityPatternPrinted = true;
-                            break;
-                        }
-                    }
-                    if ( !entityPatternPrinted ) {
-                        // TIXMLASSERT( entityPatternPrinted ) causes gcc -Wunused-but-set-variable in release
-                        TIXMLASSERT( false );
-                    }
-                    ++p;
+            // Flush the stream up until the entity, or the end of the
+            // string. This will be the entire string if there are no entities.
+            while ( p < q ) {
+                const size_t delta = q - p;
+                const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
+                Write( p, toPrint );
+                p += toPrint;
+            }
+            if ( q == end ) {
+                break;
+            }
+            // Write the entity, and keep looking.
+            bool entityPatternPrinted = false;
+            for( int i=0; i<NUM_ENTITIES; ++i ) {
+                if ( entities[i].value == *q ) {
+                    Putc( '&' );
+                    Write( entities[i].pattern, entities[i].length );
+                    Putc( ';' );
+                    entityPatternPrinted = true;
+                    break;
                 }
             }
-            ++q;
-            TIXMLASSERT( p <= q );
-        }
-        // Flush the remaining string. This will be the entire
-        // string if an entity wasn't found.
-        if ( p < q ) {
-            const size_t delta = q - p;
-            const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
-            Write( p, toPrint );
+            if ( !entityPatternPrinted ) {
+                // TIXMLASSERT( entityPatternPrinted ) causes gcc -Wunused-but-set-variable in release
+                TIXMLASSERT( false );
+            }
+            ++p;
         }
     }
     else {
@@ -3024,4 +3947,339 @@ bool XMLPrinter::Visit( const XMLUnknown& unknown )
     return true;
 }
 
+
+// --------- XMLPullParser ----------- //
+
+XMLPullParser::XMLPullParser( bool processEntities ) :
+    _processEntities( processEntities ),
+    _charBuffer( 0 ),
+    _p( 0 ),
+    _event( END_DOCUMENT ),
+    _errorID( XML_SUCCESS ),
+    _lineNum( 0 ),
+    _depth( 0 ),
+    _inTag( false ),
+    _protectedCount( 0 ),
+    _open()
+{
+}
+
+
+XMLPullParser::~XMLPullParser()
+{
+    delete [] _charBuffer;
+}
+
+
+void XMLPullParser::Reset()
+{
+    _name.Reset();
+    _value.Reset();
+    delete [] _charBuffer;
+    _charBuffer = 0;
+    _p = 0;
+    _event = END_DOCUMENT;
+    _errorID = XML_SUCCESS;
+    _lineNum = 0;
+    _depth = 0;
+    _inTag = false;
+    _protectedCount = 0;
+    _open.Clear();
+}
+
+
+XMLError XMLPullParser::LoadFile( const char* filename )
+{
+    Reset();
+    if ( !filename ) {
+        TIXMLASSERT( false );
+        Fail( XML_ERROR_FILE_COULD_NOT_BE_OPENED );
+        return _errorID;
+    }
+    FILE* fp = callfopen( filename, "rb" );
+    if ( !fp ) {
+        Fail( XML_ERROR_FILE_NOT_FOUND );
+        return _errorID;
+    }
+    LoadFile( fp );
+    fclose( fp );
+    return _errorID;
+}
+
+
+XMLError XMLPullParser::LoadFile( FILE* fp )
+{
+    Reset();
+
+    TIXML_FSEEK( fp, 0, SEEK_END );
+    const long long fileLengthSigned = TIXML_FTELL( fp );
+    TIXML_FSEEK( fp, 0, SEEK_SET );
+    if ( fileLengthSigned == -1L || static_cast<unsigned long long>(fileLengthSigned) >= static_cast<unsigned long long>(static_cast<size_t>(-1)) ) {
+        Fail( XML_ERROR_FILE_READ_ERROR );
+        return _errorID;
+    }
+    if ( fileLengthSigned == 0 ) {
+        Fail( XML_ERROR_EMPTY_DOCUMENT );
+        return _errorID;
+    }
+
+    const size_t size = static_cast<size_t>(fileLengthSigned);
+    AllocateBuffer( size );
+    if ( fread( _charBuffer, 1, size, fp ) != size ) {
+        Fail( XML_ERROR_FILE_READ_ERROR );
+        return _errorID;
+    }
+    _charBuffer[size] = 0;
+
+    Start();
+    return _errorID;
+}
+
+
+XMLError XMLPullParser::Parse( const char* xml, size_t nBytes )
+{
+    Reset();
+
+    if ( nBytes == 0 || !xml || !*xml ) {
+        Fail( XML_ERROR_EMPTY_DOCUMENT );
+        return _errorID;
+    }
+    if ( nBytes == static_cast<size_t>(-1) ) {
+        nBytes = strlen( xml );
+    }
+    AllocateBuffer( nBytes );
+    memcpy( _charBuffer, xml, nBytes );
+    _charBuffer[nBytes] = 0;
+
+    Start();
+    return _errorID;
+}
+
+
+void XMLPullParser::AllocateBuffer( size_t size )
+{
+    // Room for the terminator, and the zeroed padding the block scanners read into
+    _charBuffer = new char[size + 1 + SCAN_PADDING];
+    memset( _charBuffer + size, 0, 1 + SCAN_PADDING );
+}
+
+
+void XMLPullParser::Start()
+{
+    _lineNum = 1;
+    bool bom = false;
+    char* p = SkipBufferWhiteSpace( _charBuffer, &_lineNum );
+    p = const_cast<char*>( XMLUtil::ReadBOM( p, &bom ) );
+    if ( !*p ) {
+        Fail( XML_ERROR_EMPTY_DOCUMENT );
+        return;
+    }
+    _p = p;
+}
+
+
+XMLPullParser::Event XMLPullParser::Fail( XMLError error )
+{
+    _errorID = error;
+    _event = PARSE_ERROR;
+    return _event;
+}
+
+
+void XMLPullParser::Protect( char* end )
+{
+    TIXMLASSERT( _protectedCount < 2 );
+    _protected[_protectedCount] = end;
+    _protectedChar[_protectedCount] = *end;
+    ++_protectedCount;
+}
+
+
+const char* XMLPullParser::Name()
+{
+    if ( _event != START_ELEMENT && _event != END_ELEMENT && _event != ATTRIBUTE ) {
+        return "";
+    }
+    return _name.GetStr();
+}
+
+
+const char* XMLPullParser::Value()
+{
+    if ( _event != ATTRIBUTE && _event != TEXT ) {
+        return "";
+    }
+    return _value.GetStr();
+}
+
+
+XMLPullParser::Event XMLPullParser::Next()
+{
+    if ( Error() ) {
+        return PARSE_ERROR;
+    }
+    if ( !_p ) {
+        return _event = END_DOCUMENT;
+    }
+
+    // Undo the terminators the last event's strings may have written into the buffer
+    while ( _protectedCount > 0 ) {
+        --_protectedCount;
+        *_protected[_protectedCount] = _protectedChar[_protectedCount];
+    }
+    // The element the last event closed is gone
+    if ( _event == END_ELEMENT ) {
+        _open.PopArr( 2 );
+        --_depth;
+    }
+
+    if ( _inTag ) {
+        char* p = SkipBufferWhiteSpace( _p, &_lineNum );
+        if ( XMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+            return _event = ParseAttribute( p );
+        }
+        if ( *p == '/' && *(p+1) == '>' ) {
+            // sealed element: report its end right away
+            _inTag = false;
+            _p = p + 2;
+            char* nameEnd = _open.PeekTop();
+            _name.Set( _open[_open.Size() - 2], nameEnd, 0 );
+            Protect( nameEnd );
+            return _event = END_ELEMENT;
+        }
+        if ( *p != '>' ) {
+            return Fail( XML_ERROR_PARSING_ELEMENT );
+        }
+        _inTag = false;
+        _p = p + 1;
+    }
+    return _event = ParseContent();
+}
+
+
+XMLPullParser::Event XMLPullParser::ParseAttribute( char* p )
+{
+    // The same rules as XMLAttribute::ParseDeep
+    char* nameEnd = _name.ParseName( p );
+    p = SkipBufferWhiteSpace( nameEnd, &_lineNum );
+    if ( *p != '=' ) {
+        return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+    }
+    p = SkipBufferWhiteSpace( p + 1, &_lineNum );
+    if ( *p != '\"' && *p != '\'' ) {
+        return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+    }
+    const char endTag[2] = { *p, 0 };
+    p = _value.ParseText( p + 1, endTag, _processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES, &_lineNum );
+    if ( !p ) {
+        return Fail( XML_ERROR_PARSING_ATTRIBUTE );
+    }
+    _p = p;
+    Protect( nameEnd );
+    Protect( p - 1 );
+    return ATTRIBUTE;
+}
+
+
+XMLPullParser::Event XMLPullParser::ParseContent()
+{
+    // These are the patterns XMLDocument::Identify matches, in the same order
+    static const char* xmlHeader		= { "<?" };
+    static const char* commentHeader	= { "<!--" };
+    static const char* cdataHeader		= { "<![CDATA[" };
+    static const char* dtdHeader		= { "<!" };
+    static const char* closeHeader		= { "</" };
+
+    StrPair skipped;
+    for( ;; ) {
+        char* const start = _p;
+        const int startLine = _lineNum;
+        char* p = SkipBufferWhiteSpace( _p, &_lineNum );
+        if ( !*p ) {
+            if ( _depth > 0 ) {
+                return Fail( XML_ERROR_PARSING );
+            }
+            _p = 0;
+            return END_DOCUMENT;
+        }
+
+        if ( *p != '<' ) {
+            // Text runs up to the next markup; all of it counts, as in XMLText
+            _lineNum = startLine;
+            char* end = _value.ParseText( start, "<", _processEntities ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES, &_lineNum );
+            if ( !end ) {
+                return Fail( XML_ERROR_PARSING_TEXT );
+            }
+            _p = end - 1;
+            Protect( _p );
+            return TEXT;
+        }
+        if ( XMLUtil::StringEqual( p, xmlHeader, 2 ) ) {
+            _p = skipped.ParseText( p + 2, "?>", 0, &_lineNum );
+            if ( !_p ) {
+                return Fail( XML_ERROR_PARSING_DECLARATION );
+            }
+            continue;
+        }
+        if ( XMLUtil::StringEqual( p, commentHeader, 4 ) ) {
+            _p = skipped.ParseText( p + 4, "-->", 0, &_lineNum );
+            if ( !_p ) {
+                return Fail( XML_ERROR_PARSING_COMMENT );
+            }
+            continue;
+        }
+        if ( XMLUtil::StringEqual( p, cdataHeader, 9 ) ) {
+            char* end = _value.ParseText( p + 9, "]]>", StrPair::NEEDS_NEWLINE_NORMALIZATION, &_lineNum );
+            if ( !end ) {
+                return Fail( XML_ERROR_PARSING_CDATA );
+            }
+            _p = end;
+            Protect( end - 3 );
+            return TEXT;
+        }
+        if ( XMLUtil::StringEqual( p, dtdHeader, 2 ) ) {
+            _p = skipped.ParseText( p + 2, ">", 0, &_lineNum );
+            if ( !_p ) {
+                return Fail( XML_ERROR_PARSING_UNKNOWN );
+            }
+            continue;
+        }
+        if ( XMLUtil::StringEqual( p, closeHeader, 2 ) ) {
+            char* nameStart = p + 2;
+            char* nameEnd = _name.ParseName( nameStart );
+            if ( !nameEnd ) {
+                return Fail( XML_ERROR_PARSING_ELEMENT );
+            }
+            if ( _depth == 0
+                    || nameEnd - nameStart != _open.PeekTop() - _open[_open.Size() - 2]
+                    || strncmp( nameStart, _open[_open.Size() - 2], nameEnd - nameStart ) != 0 ) {
+                return Fail( XML_ERROR_MISMATCHED_ELEMENT );
+            }
+            p = SkipBufferWhiteSpace( nameEnd, &_lineNum );
+            if ( *p != '>' ) {
+                return Fail( XML_ERROR_PARSING_ELEMENT );
+            }
+            _p = p + 1;
+            Protect( nameEnd );
+            return END_ELEMENT;
+        }
+
+        // start tag; its attributes are read by the following calls
+        char* nameEnd = _name.ParseName( p + 1 );
+        if ( !nameEnd ) {
+            return Fail( XML_ERROR_PARSING_ELEMENT );
+        }
+        if ( _depth + 1 >= TINYXML2_MAX_ELEMENT_DEPTH ) {
+            return Fail( XML_ELEMENT_DEPTH_EXCEEDED );
+        }
+        _open.Push( p + 1 );
+        _open.Push( nameEnd );
+        ++_depth;
+        _inTag = true;
+        _p = nameEnd;
+        Protect( nameEnd );
+        return START_ELEMENT;
+    }
+}
+
 }   // namespace tinyxml2
\ No newline at end of file